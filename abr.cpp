@@ -0,0 +1,216 @@
+//
+// Adaptive bitrate controller for the stream.
+//
+// Every ABR_WINDOW ms the bytes and send time reported by the stream
+// clients are turned into a per-client bitrate and a busy ratio (the share
+// of the window spent inside socket writes). With a bitrate target the
+// controller steers the bitrate into a band around it; without one it holds
+// the frame rate by backing off whenever the senders cannot keep up.
+//
+// The quality and framesize the user chose are the best the controller will
+// ever use; it only trades down from them and climbs back as the link allows.
+// Its changes are made by the control task, in turn with the user's own.
+//
+
+#include <esp_camera.h>
+#include <esp_timer.h>
+#include <Arduino.h>
+
+#include "abr.h"
+#include "control.h"
+#include "events.h"
+#include "stream.h"
+
+// These are defined in the main .ino file
+extern int abrMode;
+extern int abrTargetKbps;
+extern int8_t streamCount;
+extern int sensorPID;
+extern bool debugData;
+
+// Measurement window in ms
+#define ABR_WINDOW 2000
+
+// Busy ratios (percent) above which the link is saturated, and below which it has room to spare
+#define ABR_BUSY_HIGH 85
+#define ABR_BUSY_LOW  50
+
+// Quality step per decision, worst quality used, and smallest frame the controller will go to
+#define ABR_QUALITY_STEP   3
+#define ABR_QUALITY_WORST  40
+#define ABR_FRAMESIZE_MIN  FRAMESIZE_QVGA
+
+static SemaphoreHandle_t abrLock = NULL;
+static uint32_t windowBytes = 0;
+static int64_t windowSendTime = 0;
+static int64_t windowStart = 0;
+
+static int activeMode = ABR_OFF;
+static int baseQuality = -1;
+static int baseFramesize = -1;
+
+// Results of the last window, reported in /status
+static int lastKbps = 0;
+static int lastBusy = 0;
+static const char * lastAction = "idle";
+
+void abrInit() {
+    if (!abrLock) abrLock = xSemaphoreCreateMutex();
+}
+
+void abrFrameSent(size_t bytes, int64_t sendTime) {
+    if (abrMode == ABR_OFF || !abrLock) return;
+    xSemaphoreTake(abrLock, portMAX_DELAY);
+    windowBytes += bytes;
+    windowSendTime += sendTime;
+    xSemaphoreGive(abrLock);
+}
+
+// The user changed quality or framesize by hand; treat the new value as the best allowed.
+// A negative value leaves that setting alone.
+void abrSetBase(int quality, int framesize) {
+    if (activeMode == ABR_OFF) return;
+    if (quality >= 0) baseQuality = quality;
+    if (framesize >= 0) baseFramesize = framesize;
+}
+
+typedef struct {
+    int quality;
+    int framesize;
+} abr_change_t;
+
+// Runs on the control task; the sensor is only written between two frames
+static void apply_change(void * arg) {
+    abr_change_t * change = (abr_change_t *)arg;
+    sensor_t * s = esp_camera_sensor_get();
+    if (!s) return;
+    bool framesize = (s->status.framesize != change->framesize);
+    bool quality = (s->status.quality != change->quality);
+    if (!framesize && !quality) return;
+    streamPauseCapture();
+    if (framesize) s->set_framesize(s, (framesize_t)change->framesize);
+    if (quality) s->set_quality(s, change->quality);
+    streamResumeCapture();
+    eventsNotify();
+}
+
+static void set_sensor(int quality, int framesize) {
+    abr_change_t change = { quality, framesize };
+    controlRun(apply_change, &change);
+}
+
+// Streaming has stopped; put back what the user chose so snapshots use it
+void abrRestore() {
+    if (activeMode == ABR_OFF) return;
+    set_sensor(baseQuality, baseFramesize);
+    activeMode = ABR_OFF;
+    lastAction = "idle";
+}
+
+int abrBaseQuality(sensor_t * s) {
+    return (activeMode != ABR_OFF) ? baseQuality : s->status.quality;
+}
+
+int abrBaseFramesize(sensor_t * s) {
+    return (activeMode != ABR_OFF) ? baseFramesize : s->status.framesize;
+}
+
+// ov3660 quality only runs from 4 to 10
+static int worst_quality() {
+    return (sensorPID == OV3660_PID) ? 10 : ABR_QUALITY_WORST;
+}
+
+// Give up some image quality; quality first, then frame size
+static const char * step_down(sensor_t * s) {
+    int quality = s->status.quality;
+    int framesize = s->status.framesize;
+    if (quality < worst_quality()) {
+        set_sensor(min(quality + ABR_QUALITY_STEP, worst_quality()), framesize);
+        return "lower quality";
+    }
+    if ((activeMode == ABR_FRAMESIZE) && (framesize > ABR_FRAMESIZE_MIN)) {
+        set_sensor(quality, framesize - 1);
+        return "smaller frame";
+    }
+    return "at minimum";
+}
+
+// Win back image quality in the reverse order it was given up
+static const char * step_up(sensor_t * s) {
+    int quality = s->status.quality;
+    int framesize = s->status.framesize;
+    if (framesize < baseFramesize) {
+        set_sensor(quality, framesize + 1);
+        return "larger frame";
+    }
+    if (quality > baseQuality) {
+        set_sensor(max(quality - ABR_QUALITY_STEP, baseQuality), framesize);
+        return "raise quality";
+    }
+    return "at maximum";
+}
+
+void abrUpdate() {
+    sensor_t * s = esp_camera_sensor_get();
+    if (!s) return;
+
+    if (abrMode != activeMode) {
+        abrRestore();
+        if (abrMode != ABR_OFF) {
+            baseQuality = s->status.quality;
+            baseFramesize = s->status.framesize;
+            activeMode = abrMode;
+            lastAction = "hold";
+        }
+        windowStart = 0;
+    }
+    if (activeMode == ABR_OFF) return;
+
+    int64_t now = esp_timer_get_time();
+    if (windowStart == 0) windowStart = now;
+    int64_t window = (now - windowStart) / 1000;
+    if (window < ABR_WINDOW) return;
+
+    xSemaphoreTake(abrLock, portMAX_DELAY);
+    uint32_t bytes = windowBytes;
+    int64_t sendTime = windowSendTime;
+    windowBytes = 0;
+    windowSendTime = 0;
+    xSemaphoreGive(abrLock);
+    windowStart = now;
+
+    int clients = streamCount;
+    if (clients == 0 || bytes == 0) return;
+    lastKbps = (int)((int64_t)bytes * 8 / window / clients);
+    lastBusy = (int)(sendTime / 10 / window / clients);
+
+    bool saturated = (lastBusy > ABR_BUSY_HIGH);
+    bool spare = (lastBusy < ABR_BUSY_LOW);
+    if (abrTargetKbps > 0) {
+        if (saturated || (lastKbps > abrTargetKbps * 110 / 100)) lastAction = step_down(s);
+        else if (spare && (lastKbps < abrTargetKbps * 75 / 100)) lastAction = step_up(s);
+        else lastAction = "hold";
+    } else {
+        if (saturated) lastAction = step_down(s);
+        else if (spare) lastAction = step_up(s);
+        else lastAction = "hold";
+    }
+    if (debugData) {
+        Serial.printf("ABR: %ikbps, busy %i%%, quality %u, framesize %u: %s\r\n",
+            lastKbps, lastBusy, s->status.quality, s->status.framesize, lastAction);
+    }
+}
+
+// Append the controller's latest results to a JSON object under construction; its settings are in settings.cpp
+char * abrStatus(char * p) {
+    p+=sprintf(p, "\"abr_kbps\":%d,", lastKbps);
+    p+=sprintf(p, "\"abr_busy\":%d,", lastBusy);
+    p+=sprintf(p, "\"abr_action\":\"%s\",", lastAction);
+    return p;
+}
+
+void abrGetStatus(int * kbps, int * busy, const char ** action) {
+    *kbps = lastKbps;
+    *busy = lastBusy;
+    *action = lastAction;
+}
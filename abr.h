@@ -0,0 +1,26 @@
+//
+// Adaptive bitrate controller for the stream.
+//
+// Stream clients report every frame they send; once per measurement window
+// the capture task asks the controller to compare what was achieved with the
+// target and step the JPEG quality (and optionally the frame size) to suit.
+//
+
+#pragma once
+
+#include <esp_camera.h>
+
+// abrMode values
+#define ABR_OFF        0   // quality and framesize are left alone
+#define ABR_QUALITY    1   // adjust JPEG quality only
+#define ABR_FRAMESIZE  2   // adjust quality, then framesize once quality runs out
+
+extern void abrInit();
+extern void abrFrameSent(size_t bytes, int64_t sendTime);
+extern void abrUpdate();
+extern void abrSetBase(int quality, int framesize);
+extern void abrRestore();
+extern int abrBaseQuality(sensor_t * s);
+extern int abrBaseFramesize(sensor_t * s);
+extern char * abrStatus(char * p);
+extern void abrGetStatus(int * kbps, int * busy, const char ** action);
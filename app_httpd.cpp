@@ -30,12 +30,22 @@
 #include "src/favicons.h"
 #include "src/logo.h"
 #include "storage.h"
+#include "stream.h"
+#include "abr.h"
+#include "metrics.h"
+#include "events.h"
+#include "led.h"
+#include "exposure.h"
+#include "settings.h"
+#include "control.h"
+#include "src/cbor.h"
 
 #include "src/prefs.h"
 
 // Functions from the main .ino
 extern void flashLED(int flashtime);
 extern void setLamp(int newVal);
+extern void fadeLamp(int newVal);
 extern void printLocalTime(bool extraData);
 
 // External variables declared in the main .ino
@@ -57,7 +67,7 @@ extern int8_t streamCount;
 extern unsigned long streamsServed;
 extern unsigned long imagesServed;
 extern int myRotation;
-extern int minFrameTime;
+extern int captureMaxAge;
 extern int lampVal;
 extern bool autoLamp;
 extern bool filesystem;
@@ -77,17 +87,9 @@ typedef struct {
         size_t len;
 } jpg_chunking_t;
 
-#define PART_BOUNDARY "123456789000000000000987654321"
-static const char* _STREAM_CONTENT_TYPE = "multipart/x-mixed-replace;boundary=" PART_BOUNDARY;
-static const char* _STREAM_BOUNDARY = "\r\n--" PART_BOUNDARY "\r\n";
-static const char* _STREAM_PART = "Content-Type: image/jpeg\r\nContent-Length: %u\r\n\r\n";
-
 httpd_handle_t stream_httpd = NULL;
 httpd_handle_t camera_httpd = NULL;
 
-// Flag that can be set to kill all active streams
-bool streamKill;
-
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -153,6 +155,14 @@ void serialDump() {
     int McuTf = temprature_sens_read(); // fahrenheit
     Serial.printf("System up: %" PRId64 ":%02i:%02i:%02i (d:h:m:s)\r\n", upDays, upHours, upMin, upSec);
     Serial.printf("Active streams: %i, Previous streams: %lu, Images captured: %lu\r\n", streamCount, streamsServed, imagesServed);
+    Serial.printf("Frames captured: %u, dropped: %u\r\n", frameRingSeq(), frameRingDropped());
+    stream_stats_t stats[MAX_STREAMS];
+    int clients = streamGetStats(stats, MAX_STREAMS);
+    for (int i = 0; i < clients; i++) {
+        Serial.printf("Stream %i%s: sent %u, dropped %u, skipped %u, pending %uB, %.1f fps (target %.1f)\r\n", stats[i].fd,
+            stats[i].ws ? " (ws)" : stats[i].raw ? " (raw)" : "", stats[i].frames, stats[i].dropped, stats[i].skipped, (uint32_t)stats[i].pending,
+            stats[i].fps, stats[i].fpsTarget);
+    }
     Serial.printf("CPU Freq: %i MHz, Xclk Freq: %i MHz\r\n", ESP.getCpuFreqMHz(), xclk);
     Serial.printf("MCU temperature : %i C, %i F  (approximate)\r\n", McuTc, McuTf);
     Serial.printf("Heap: %i, free: %i, min free: %i, max block: %i\r\n", ESP.getHeapSize(), ESP.getFreeHeap(), ESP.getMinFreeHeap(), ESP.getMaxAllocHeap());
@@ -179,185 +189,405 @@ void serialDump() {
     return;
 }
 
-static esp_err_t capture_handler(httpd_req_t *req){
-    camera_fb_t * fb = NULL;
-    esp_err_t res = ESP_OK;
+// Burst captures are sent as a multipart/mixed response, one part per frame.
+// The whole burst runs in the httpd task, holding off every other request on
+// the control port, so it may not be spread over more than a few seconds.
+#define CAPTURE_BURST_MAX 30
+#define CAPTURE_BURST_TIME_MAX 3000
+#define CAPTURE_BOUNDARY "123456789000000000000987654321"
 
-    Serial.println("Capture Requested");
-    if (autoLamp && (lampVal != -1)) {
-        setLamp(lampVal);
-        delay(75); // coupled with the status led flash this gives ~150ms for lamp to settle.
-    }
-    flashLED(75); // little flash of status LED
-
-    int64_t fr_start = esp_timer_get_time();
+// Send 'count' consecutive frames at least 'interval' ms apart as one multipart response
+static esp_err_t capture_burst(httpd_req_t *req, int count, int interval){
+    httpd_resp_set_type(req, "multipart/mixed;boundary=" CAPTURE_BOUNDARY);
+    httpd_resp_set_hdr(req, "Access-Control-Allow-Origin", "*");
 
-    fb = esp_camera_fb_get();
-    if (!fb) {
-        Serial.println("CAPTURE: failed to acquire frame");
+    esp_err_t res = ESP_OK;
+    int64_t start = esp_timer_get_time();
+    int sent = 0;
+    char part[160];
+    for (int i = 0; (i < count) && (res == ESP_OK); i++) {
+        int64_t wait = start + (int64_t)i * interval * 1000 - esp_timer_get_time();
+        if (wait > 0) delay(wait / 1000);
+        frame_t * frame = streamGrabFrame();
+        if (!frame) {
+            Serial.println("CAPTURE: failed to acquire frame");
+            res = ESP_FAIL;
+            break;
+        }
+        int len = sprintf(part, "\r\n--" CAPTURE_BOUNDARY "\r\n"
+                                "Content-Type: image/jpeg\r\n"
+                                "Content-Length: %u\r\n"
+                                "X-Timestamp: %lld.%06lld\r\n"
+                                "X-Frame-Sequence: %u\r\n\r\n",
+                          (uint32_t)frame->len, frame->timestamp / 1000000, frame->timestamp % 1000000, frame->seq);
+        res = httpd_resp_send_chunk(req, part, len);
+        if (res == ESP_OK) res = httpd_resp_send_chunk(req, (const char *)frame->buf, frame->len);
+        frameRingRelease(frame);
+        if (res == ESP_OK) sent++;
+    }
+    if (res == ESP_OK) {
+        res = httpd_resp_send_chunk(req, "\r\n--" CAPTURE_BOUNDARY "--\r\n", strlen("\r\n--" CAPTURE_BOUNDARY "--\r\n"));
+        if (res == ESP_OK) res = httpd_resp_send_chunk(req, NULL, 0);
+    } else if (sent == 0) {
         httpd_resp_send_500(req);
-        if (autoLamp && (lampVal != -1)) setLamp(0);
-        return ESP_FAIL;
     }
+    if (debugData) {
+        Serial.printf("BURST: %i of %i frames in %ums\r\n", sent, count, (uint32_t)((esp_timer_get_time() - start) / 1000));
+    }
+    imagesServed += sent;
+    return res;
+}
+
+// Send one frame as a JPEG image and release it; the headers say whether it was taken
+// from the running stream and how old it was when sent
+static esp_err_t capture_send(httpd_req_t *req, frame_t * frame, bool cached){
+    int64_t fr_start = esp_timer_get_time();
+    char age[12];
+    sprintf(age, "%u", (uint32_t)((fr_start - frame->timestamp) / 1000));
 
     httpd_resp_set_type(req, "image/jpeg");
     httpd_resp_set_hdr(req, "Content-Disposition", "inline; filename=capture.jpg");
     httpd_resp_set_hdr(req, "Access-Control-Allow-Origin", "*");
+    httpd_resp_set_hdr(req, "X-Frame-Cached", cached ? "1" : "0");
+    httpd_resp_set_hdr(req, "X-Frame-Age", age);
 
-    size_t fb_len = 0;
-    if(fb->format == PIXFORMAT_JPEG){
-        fb_len = fb->len;
-        res = httpd_resp_send(req, (const char *)fb->buf, fb->len);
-    } else {
-        res = ESP_FAIL;
-        Serial.println("Capture Error: Non-JPEG image returned by camera module");
-    }
-    esp_camera_fb_return(fb);
-    fb = NULL;
+    size_t fb_len = frame->len;
+    esp_err_t res = httpd_resp_send(req, (const char *)frame->buf, frame->len);
+    frameRingRelease(frame);
 
     int64_t fr_end = esp_timer_get_time();
     if (debugData) {
-        Serial.printf("JPG: %uB %ums\r\n", (uint32_t)(fb_len), (uint32_t)((fr_end - fr_start)/1000));
+        Serial.printf("JPG: %uB %ums, %sage %sms\r\n", (uint32_t)(fb_len), (uint32_t)((fr_end - fr_start)/1000), cached ? "cached, " : "", age);
     }
     imagesServed++;
-    if (autoLamp && (lampVal != -1)) {
-        setLamp(0);
-    }
     return res;
 }
 
-static esp_err_t stream_handler(httpd_req_t *req){
-    camera_fb_t * fb = NULL;
+static esp_err_t capture_handler(httpd_req_t *req){
     esp_err_t res = ESP_OK;
-    size_t _jpg_buf_len = 0;
-    uint8_t * _jpg_buf = NULL;
-    char * part_buf[64];
 
-    streamKill = false;
+    // ?burst=N&interval=ms asks for several frames in one response
+    int burst = 1;
+    int interval = 0;
+    char query[64];
+    if (httpd_req_get_url_query_str(req, query, sizeof(query)) == ESP_OK) {
+        char value[12];
+        if (httpd_query_key_value(query, "burst", value, sizeof(value)) == ESP_OK) {
+            burst = constrain(atoi(value), 1, CAPTURE_BURST_MAX);
+        }
+        if (httpd_query_key_value(query, "interval", value, sizeof(value)) == ESP_OK) {
+            interval = max(atoi(value), 0);
+        }
+    }
+    if ((burst > 1) && ((int64_t)(burst - 1) * interval > CAPTURE_BURST_TIME_MAX)) {
+        return httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Burst too long");
+    }
+
+    Serial.println("Capture Requested");
 
-    Serial.println("Stream requested");
-    if (autoLamp && (lampVal != -1)) setLamp(lampVal);
-    streamCount = 1;  // at present we only have one stream handler, so values are 0 or 1..
-    flashLED(75);     // double flash of status LED
-    delay(75);
-    flashLED(75);
-
-    static int64_t last_frame = 0;
-    if(!last_frame) {
-        last_frame = esp_timer_get_time();
-    }
-
-    res = httpd_resp_set_type(req, _STREAM_CONTENT_TYPE);
-    if(res != ESP_OK){
-        streamCount = 0;
-        if (autoLamp && (lampVal != -1)) setLamp(0);
-        Serial.println("STREAM: failed to set HTTP response type");
+    // A running stream keeps the lamp lit and the ring full; a recent enough frame needs no new capture
+    if ((burst == 1) && (streamCount > 0) && (captureMaxAge > 0)) {
+        frame_t * frame = frameRingLatest();
+        if (frame && (esp_timer_get_time() - frame->timestamp <= (int64_t)captureMaxAge * 1000)) {
+            return capture_send(req, frame, true);
+        }
+        if (frame) frameRingRelease(frame);
+    }
+
+    ledFlash(75); // little flash of status LED
+
+    // Lighting the lamp changes the scene; wait for the auto exposure to follow it
+    frame_t * frame = NULL;
+    char settle[12];
+    if (autoLamp && (lampVal != -1) && (streamCount == 0)) {
+        // setLamp() only queues the change; the exposure must settle against the lit scene
+        setLamp(lampVal);
+        controlWait();
+        int settleTime;
+        frame = exposureSettle(EXPOSURE_SETTLE_TIMEOUT, &settleTime);
+        if (settleTime >= 0) sprintf(settle, "%i", settleTime);
+        else strcpy(settle, "timeout");
+        httpd_resp_set_hdr(req, "X-Exposure-Settle", settle);
+    }
+
+    if (burst > 1) {
+        if (frame) frameRingRelease(frame);
+        res = capture_burst(req, burst, interval);
+        if (autoLamp && (lampVal != -1) && (streamCount == 0)) fadeLamp(0);
         return res;
     }
 
-    httpd_resp_set_hdr(req, "Access-Control-Allow-Origin", "*");
+    // Served from the frame ring; this shares the stream capture when one is running
+    if (!frame) frame = streamGrabFrame();
+    if (!frame) {
+        Serial.println("CAPTURE: failed to acquire frame");
+        httpd_resp_send_500(req);
+        if (autoLamp && (lampVal != -1) && (streamCount == 0)) fadeLamp(0);
+        return ESP_FAIL;
+    }
 
-    if(res == ESP_OK){
-        res = httpd_resp_send_chunk(req, _STREAM_BOUNDARY, strlen(_STREAM_BOUNDARY));
+    res = capture_send(req, frame, false);
+    if (autoLamp && (lampVal != -1) && (streamCount == 0)) {
+        fadeLamp(0);
     }
+    return res;
+}
 
-    while(true){
-        fb = esp_camera_fb_get();
-        if (!fb) {
-            Serial.println("STREAM: failed to acquire frame");
-            res = ESP_FAIL;
+static esp_err_t stream_handler(httpd_req_t *req){
+    Serial.println("Stream requested");
+    ledDoubleFlash(75);
+
+    // Hand the connection over to the stream broadcaster, which shares a
+    // single capture loop between all connected clients
+    return streamStartClient(req);
+}
+
+extern bool    ssid_changed ;
+extern char    newSSID[] ;
+
+// Clients that send 'Accept: application/cbor' get CBOR instead of JSON from /status, /info and /control
+#define CBOR_TYPE "application/cbor"
+
+static bool wants_cbor(httpd_req_t *req) {
+    char accept[128];
+    esp_err_t res = httpd_req_get_hdr_value_str(req, "Accept", accept, sizeof(accept));
+    return ((res == ESP_OK) || (res == ESP_ERR_HTTPD_RESULT_TRUNC)) && strstr(accept, CBOR_TYPE);
+}
+
+// Batched /control: several settings in one request, checked together and applied between two frames
+#define CONTROL_BATCH_MAX 16
+#define CONTROL_QUERY_MAX 512
+#define CONTROL_BODY_MAX 512
+
+typedef struct {
+    const char * name;
+    const char * value;
+    const setting_t * setting;
+    int val;
+    const char * result;
+} control_item_t;
+
+// Split "a=1&b=2" into name/value pairs, in place; -1 if malformed or too many
+static int parse_query_pairs(char * p, control_item_t * items, int max) {
+    int count = 0;
+    while (*p) {
+        if (count == max) return -1;
+        items[count].name = p;
+        char * eq = strchr(p, '=');
+        char * amp = strchr(p, '&');
+        if (!eq || (amp && (amp < eq))) return -1;
+        *eq = 0;
+        items[count++].value = eq + 1;
+        if (!amp) break;
+        *amp = 0;
+        p = amp + 1;
+    }
+    return count;
+}
+
+static char * skip_space(char * p) {
+    while ((*p == ' ') || (*p == '\t') || (*p == '\r') || (*p == '\n')) p++;
+    return p;
+}
+
+// Split a flat JSON object, {"a":1,"b":true}, into name/value pairs, in place; -1 if malformed or too many
+static int parse_json_pairs(char * p, control_item_t * items, int max) {
+    int count = 0;
+    p = skip_space(p);
+    if (*p++ != '{') return -1;
+    p = skip_space(p);
+    if (*p == '}') return 0;
+    while (true) {
+        if ((count == max) || (*p++ != '"')) return -1;
+        items[count].name = p;
+        if (!(p = strchr(p, '"'))) return -1;
+        *p = 0;
+        p = skip_space(p + 1);
+        if (*p++ != ':') return -1;
+        p = skip_space(p);
+        char * end;
+        if (*p == '"') {
+            items[count].value = ++p;
+            if (!(end = strchr(p, '"'))) return -1;
+            p = end + 1;
         } else {
-            if(fb->format != PIXFORMAT_JPEG){
-                Serial.println("STREAM: Non-JPEG frame returned by camera module");
-                res = ESP_FAIL;
-            } else {
-                _jpg_buf_len = fb->len;
-                _jpg_buf = fb->buf;
-            }
-        }
-        if(res == ESP_OK){
-            size_t hlen = snprintf((char *)part_buf, 64, _STREAM_PART, _jpg_buf_len);
-            res = httpd_resp_send_chunk(req, (const char *)part_buf, hlen);
+            items[count].value = p;
+            while (isalnum(*p) || (*p == '-') || (*p == '+') || (*p == '.')) p++;
+            if (p == items[count].value) return -1;
+            end = p;
         }
-        if(res == ESP_OK){
-            res = httpd_resp_send_chunk(req, (const char *)_jpg_buf, _jpg_buf_len);
+        p = skip_space(p);
+        char sep = *p++;
+        *end = 0;
+        if (!strcmp(items[count].value, "true")) items[count].value = "1";
+        else if (!strcmp(items[count].value, "false")) items[count].value = "0";
+        count++;
+        if (sep == '}') return count;
+        if (sep != ',') return -1;
+        p = skip_space(p);
+    }
+}
+
+// Check every item before changing anything, then apply them all in settings table order
+static esp_err_t control_batch(httpd_req_t *req, control_item_t * items, int count) {
+    bool valid = true;
+    for (int i = 0; i < count; i++) {
+        char * end;
+        items[i].setting = settingFind(items[i].name);
+        items[i].val = strtol(items[i].value, &end, 10);
+        if (!items[i].setting) items[i].result = "unknown";
+        else if ((end == items[i].value) || *end) items[i].result = "not a number";
+        else if (!settingValid(items[i].setting, items[i].val)) items[i].result = "out of range";
+        else items[i].result = "ok";
+        if (strcmp(items[i].result, "ok")) valid = false;
+    }
+
+    bool failed = false;
+    if (valid && (count > 0)) {
+        // Table entries are in dependency order (eg aec before aec_value); keep request order for repeats
+        int order[CONTROL_BATCH_MAX];
+        for (int i = 0; i < count; i++) {
+            int j = i;
+            while ((j > 0) && (items[order[j - 1]].setting > items[i].setting)) {
+                order[j] = order[j - 1];
+                j--;
+            }
+            order[j] = i;
         }
-        if(res == ESP_OK){
-            res = httpd_resp_send_chunk(req, _STREAM_BOUNDARY, strlen(_STREAM_BOUNDARY));
+        control_change_t changes[CONTROL_BATCH_MAX];
+        for (int i = 0; i < count; i++) {
+            changes[i].setting = items[order[i]].setting;
+            changes[i].value = items[order[i]].val;
         }
-        if(fb){
-            esp_camera_fb_return(fb);
-            fb = NULL;
-            _jpg_buf = NULL;
-        } else if(_jpg_buf){
-            free(_jpg_buf);
-            _jpg_buf = NULL;
+        failed = controlApply(changes, count) > 0;
+        for (int i = 0; i < count; i++) {
+            if (changes[i].result != 0) items[order[i]].result = "failed";
         }
-        if(res != ESP_OK){
-            // This is the error exit point from the stream loop.
-            // We end the stream here only if a Hard failure has been encountered or the connection has been interrupted.
-            Serial.printf("Stream failed, code = %i : %s\r\n", res, esp_err_to_name(res));
-            break;
+        eventsNotify();
+    } else {
+        for (int i = 0; i < count; i++) {
+            if (!strcmp(items[i].result, "ok")) items[i].result = "not applied";
         }
-        if((res != ESP_OK) || streamKill){
-            // We end the stream here when a kill is signalled.
-            Serial.printf("Stream killed\r\n");
-            break;
+    }
+
+    char json[CONTROL_BATCH_MAX * 56 + 4];
+    char * p = json;
+    if (wants_cbor(req)) {
+        cbor_writer_t w;
+        cborWriterInit(&w, (uint8_t *)json, sizeof(json));
+        cborMapStart(&w);
+        for (int i = 0; i < count; i++) {
+            cborTextLen(&w, items[i].name, min(strlen(items[i].name), (size_t)31));
+            cborText(&w, items[i].result);
         }
-        int64_t frame_time = esp_timer_get_time() - last_frame;
-        frame_time /= 1000;
-        int32_t frame_delay = (minFrameTime > frame_time) ? minFrameTime - frame_time : 0;
-        delay(frame_delay);
-
-        if (debugData) {
-            Serial.printf("MJPG: %uB %ums, delay: %ums, framerate (%.1ffps)\r\n",
-                (uint32_t)(_jpg_buf_len),
-                (uint32_t)frame_time, frame_delay, 1000.0 / (uint32_t)(frame_time + frame_delay));
+        cborMapEnd(&w);
+        p += w.len;
+        httpd_resp_set_type(req, CBOR_TYPE);
+    } else {
+        *p++ = '{';
+        for (int i = 0; i < count; i++) {
+            p+=snprintf(p, 56, "%s\"%.31s\":\"%s\"", i ? "," : "", items[i].name, items[i].result);
         }
-        last_frame = esp_timer_get_time();
+        *p++ = '}';
+        *p = 0;
+        httpd_resp_set_type(req, "application/json");
     }
+    if (!valid) httpd_resp_set_status(req, HTTPD_400);
+    else if (failed) httpd_resp_set_status(req, HTTPD_500);
+    httpd_resp_set_hdr(req, "Access-Control-Allow-Origin", "*");
+    return httpd_resp_send(req, json, p - json);
+}
 
-    streamsServed++;
-    streamCount = 0;
-    if (autoLamp && (lampVal != -1)) setLamp(0);
-    Serial.println("Stream ended");
-    last_frame = 0;
-    return res;
+// Read a CBOR map of name: value (integer, boolean or text) into 'items', copying the strings
+// into 'scratch' so that they can be NUL terminated; -1 if malformed or too many
+static int parse_cbor_pairs(const uint8_t * body, size_t len, char * scratch, size_t size, control_item_t * items, int max) {
+    cbor_reader_t r;
+    cbor_item_t item;
+    cborReaderInit(&r, body, len);
+    if (!cborRead(&r, &item) || (item.type != CBOR_MAP)) return -1;
+    bool indefinite = (item.len == CBOR_INDEFINITE);
+    size_t pairs = item.len;
+    char * p = scratch;
+    char * end = scratch + size;
+    int count = 0;
+    while (indefinite || (pairs-- > 0)) {
+        if (!cborRead(&r, &item)) return -1;
+        if (indefinite && (item.type == CBOR_BREAK)) break;
+        if ((item.type != CBOR_TEXT) || (count == max) || (item.len + 24 > (size_t)(end - p))) return -1;
+        items[count].name = p;
+        memcpy(p, item.data, item.len);
+        p += item.len;
+        *p++ = 0;
+        if (!cborRead(&r, &item)) return -1;
+        items[count].value = p;
+        if ((item.type == CBOR_INT) || (item.type == CBOR_BOOL)) {
+            p += snprintf(p, end - p, "%lld", (long long)item.i) + 1;
+        } else if ((item.type == CBOR_TEXT) && (item.len < (size_t)(end - p))) {
+            memcpy(p, item.data, item.len);
+            p += item.len;
+            *p++ = 0;
+        } else {
+            return -1;
+        }
+        count++;
+    }
+    return count;
 }
 
-extern bool    ssid_changed ;
-extern char    newSSID[] ;
+// POST /control takes the settings as a JSON object, a form encoded body or a CBOR map
+static esp_err_t cmd_post_handler(httpd_req_t *req){
+    char body[CONTROL_BODY_MAX + 1];
+    char type[32];
+    control_item_t items[CONTROL_BATCH_MAX];
+
+    ledFlash(75);
+    if (critERR.length() > 0) return httpd_resp_send_500(req);
+    if (req->content_len > CONTROL_BODY_MAX) {
+        return httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Body too large");
+    }
+    size_t len = 0;
+    while (len < req->content_len) {
+        int got = httpd_req_recv(req, body + len, req->content_len - len);
+        if (got <= 0) return ESP_FAIL;
+        len += got;
+    }
+    body[len] = 0;
+    if ((httpd_req_get_hdr_value_str(req, "Content-Type", type, sizeof(type)) == ESP_OK) && strstr(type, CBOR_TYPE)) {
+        char * scratch = (char*)malloc(CONTROL_BATCH_MAX * 64);
+        if (!scratch) return httpd_resp_send_500(req);
+        int count = parse_cbor_pairs((const uint8_t *)body, len, scratch, CONTROL_BATCH_MAX * 64, items, CONTROL_BATCH_MAX);
+        esp_err_t res = (count < 0) ? httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Malformed settings")
+                                    : control_batch(req, items, count);
+        free(scratch);
+        return res;
+    }
+    char * start = skip_space(body);
+    int count = (*start == '{') ? parse_json_pairs(start, items, CONTROL_BATCH_MAX)
+                                : parse_query_pairs(start, items, CONTROL_BATCH_MAX);
+    if (count < 0) return httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Malformed settings");
+    return control_batch(req, items, count);
+}
 
 static esp_err_t cmd_handler(httpd_req_t *req){
-    char*  buf;
-    size_t buf_len;
+    char query[CONTROL_QUERY_MAX];
     char variable[32] = {0,};
     char value[32] = {0,};
 
-    flashLED(75);
+    ledFlash(75);
 
-    buf_len = httpd_req_get_url_query_len(req) + 1;
-    if (buf_len > 1) {
-        buf = (char*)malloc(buf_len);
-        if(!buf){
-            httpd_resp_send_500(req);
-            return ESP_FAIL;
-        }
-        if (httpd_req_get_url_query_str(req, buf, buf_len) == ESP_OK) {
-            if (httpd_query_key_value(buf, "var", variable, sizeof(variable)) == ESP_OK &&
-                httpd_query_key_value(buf, "val", value, sizeof(value)) == ESP_OK) {
-            } else {
-                free(buf);
-                httpd_resp_send_404(req);
-                return ESP_FAIL;
-            }
-        } else {
-            free(buf);
-            httpd_resp_send_404(req);
-            return ESP_FAIL;
-        }
-        free(buf);
-    } else {
+    if (httpd_req_get_url_query_str(req, query, sizeof(query)) != ESP_OK) {
+        httpd_resp_send_404(req);
+        return ESP_FAIL;
+    }
+    if (httpd_query_key_value(query, "var", variable, sizeof(variable)) != ESP_OK) {
+        // No var=, so this is a batch of <setting>=<value> pairs
+        if (critERR.length() > 0) return httpd_resp_send_500(req);
+        control_item_t items[CONTROL_BATCH_MAX];
+        int count = parse_query_pairs(query, items, CONTROL_BATCH_MAX);
+        if (count < 0) return httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Malformed settings");
+        return control_batch(req, items, count);
+    }
+    if (httpd_query_key_value(query, "val", value, sizeof(value)) != ESP_OK) {
         httpd_resp_send_404(req);
         return ESP_FAIL;
     }
@@ -365,7 +595,7 @@ static esp_err_t cmd_handler(httpd_req_t *req){
     if (critERR.length() > 0) return httpd_resp_send_500(req);
 
     int val = atoi(value);
-    sensor_t * s = esp_camera_sensor_get();
+    const setting_t * setting = settingFind(variable);
     int res = 0;
     Serial.println("Command") ;
     //
@@ -376,52 +606,10 @@ static esp_err_t cmd_handler(httpd_req_t *req){
     {
          // All done, the command was an API extension
     }
-    else if(!strcmp(variable, "framesize")) {
-        if(s->pixformat == PIXFORMAT_JPEG) res = s->set_framesize(s, (framesize_t)val);
-    }
-    else if(!strcmp(variable, "quality")) res = s->set_quality(s, val);
-    else if(!strcmp(variable, "xclk")) { xclk = val; res = s->set_xclk(s, LEDC_TIMER_0, val); }
-    else if(!strcmp(variable, "contrast")) res = s->set_contrast(s, val);
-    else if(!strcmp(variable, "brightness")) res = s->set_brightness(s, val);
-    else if(!strcmp(variable, "saturation")) res = s->set_saturation(s, val);
-    else if(!strcmp(variable, "gainceiling")) res = s->set_gainceiling(s, (gainceiling_t)val);
-    else if(!strcmp(variable, "colorbar")) res = s->set_colorbar(s, val);
-    else if(!strcmp(variable, "awb")) res = s->set_whitebal(s, val);
-    else if(!strcmp(variable, "agc")) res = s->set_gain_ctrl(s, val);
-    else if(!strcmp(variable, "aec")) res = s->set_exposure_ctrl(s, val);
-    else if(!strcmp(variable, "hmirror")) res = s->set_hmirror(s, val);
-    else if(!strcmp(variable, "vflip")) res = s->set_vflip(s, val);
-    else if(!strcmp(variable, "awb_gain")) res = s->set_awb_gain(s, val);
-    else if(!strcmp(variable, "agc_gain")) res = s->set_agc_gain(s, val);
-    else if(!strcmp(variable, "aec_value")) res = s->set_aec_value(s, val);
-    else if(!strcmp(variable, "aec2")) res = s->set_aec2(s, val);
-    else if(!strcmp(variable, "dcw")) res = s->set_dcw(s, val);
-    else if(!strcmp(variable, "bpc")) res = s->set_bpc(s, val);
-    else if(!strcmp(variable, "wpc")) res = s->set_wpc(s, val);
-    else if(!strcmp(variable, "raw_gma")) res = s->set_raw_gma(s, val);
-    else if(!strcmp(variable, "lenc")) res = s->set_lenc(s, val);
-    else if(!strcmp(variable, "special_effect")) res = s->set_special_effect(s, val);
-    else if(!strcmp(variable, "wb_mode")) res = s->set_wb_mode(s, val);
-    else if(!strcmp(variable, "ae_level")) res = s->set_ae_level(s, val);
-    else if(!strcmp(variable, "rotate")) myRotation = val;
-    else if(!strcmp(variable, "min_frame_time")) minFrameTime = val;
-    else if(!strcmp(variable, "autolamp") && (lampVal != -1)) {
-        autoLamp = val;
-        if (autoLamp) {
-           if (streamCount > 0) setLamp(lampVal);
-           else setLamp(0);
-        } else {
-            setLamp(lampVal);
-        }
-    }
-    else if(!strcmp(variable, "lamp") && (lampVal != -1)) {
-        lampVal = constrain(val,0,100);
-        if (autoLamp) {
-           if (streamCount > 0) setLamp(lampVal);
-           else setLamp(0);
-        } else {
-            setLamp(lampVal);
-        }
+    else if (setting) {
+        // Made by the control task, between two frames
+        control_change_t change = { setting, val, 0 };
+        res = controlApply(&change, 1) ? -1 : 0;
     }
     else if(!strcmp(variable, "save_prefs")) {
         if (filesystem) savePrefs(SPIFFS);
@@ -455,60 +643,189 @@ static esp_err_t cmd_handler(httpd_req_t *req){
     if(res){
         return httpd_resp_send_500(req);
     }
+    eventsNotify();
     httpd_resp_set_hdr(req, "Access-Control-Allow-Origin", "*");
     return httpd_resp_send(req, NULL, 0);
 }
 
-static esp_err_t status_handler(httpd_req_t *req){
-    static char json_response[1024];
-    char * p = json_response;
+// Build the settings and state part of the /status JSON object into 'p' and
+// return the end of it. This is what /events pushes when it changes; it is
+// cached in events.cpp, so call eventsNotify() after changing anything here.
+char * statusJson(char * p) {
     *p++ = '{';
     // Do not get attempt to get sensor when in error; causes a panic..
     if (critERR.length() == 0) {
-        sensor_t * s = esp_camera_sensor_get();
-        p+=sprintf(p, "\"lamp\":%d,", lampVal);
-        p+=sprintf(p, "\"autolamp\":%d,", autoLamp);
-        p+=sprintf(p, "\"min_frame_time\":%d,", minFrameTime);
-        p+=sprintf(p, "\"framesize\":%u,", s->status.framesize);
-        p+=sprintf(p, "\"quality\":%u,", s->status.quality);
-        p+=sprintf(p, "\"xclk\":%u,", xclk);
-        p+=sprintf(p, "\"brightness\":%d,", s->status.brightness);
-        p+=sprintf(p, "\"contrast\":%d,", s->status.contrast);
-        p+=sprintf(p, "\"saturation\":%d,", s->status.saturation);
-        p+=sprintf(p, "\"sharpness\":%d,", s->status.sharpness);
-        p+=sprintf(p, "\"special_effect\":%u,", s->status.special_effect);
-        p+=sprintf(p, "\"wb_mode\":%u,", s->status.wb_mode);
-        p+=sprintf(p, "\"awb\":%u,", s->status.awb);
-        p+=sprintf(p, "\"awb_gain\":%u,", s->status.awb_gain);
-        p+=sprintf(p, "\"aec\":%u,", s->status.aec);
-        p+=sprintf(p, "\"aec2\":%u,", s->status.aec2);
-        p+=sprintf(p, "\"ae_level\":%d,", s->status.ae_level);
-        p+=sprintf(p, "\"aec_value\":%u,", s->status.aec_value);
-        p+=sprintf(p, "\"agc\":%u,", s->status.agc);
-        p+=sprintf(p, "\"agc_gain\":%u,", s->status.agc_gain);
-        p+=sprintf(p, "\"gainceiling\":%u,", s->status.gainceiling);
-        p+=sprintf(p, "\"bpc\":%u,", s->status.bpc);
-        p+=sprintf(p, "\"wpc\":%u,", s->status.wpc);
-        p+=sprintf(p, "\"raw_gma\":%u,", s->status.raw_gma);
-        p+=sprintf(p, "\"lenc\":%u,", s->status.lenc);
-        p+=sprintf(p, "\"vflip\":%u,", s->status.vflip);
-        p+=sprintf(p, "\"hmirror\":%u,", s->status.hmirror);
-        p+=sprintf(p, "\"dcw\":%u,", s->status.dcw);
-        p+=sprintf(p, "\"colorbar\":%u,", s->status.colorbar);
+        p = settingsJson(p, false);
         p+=sprintf(p, "\"cam_name\":\"%s\",", myName);
         p+=sprintf(p, "\"code_ver\":\"%s\",", myVer);
-        p+=sprintf(p, "\"rotate\":\"%d\",", myRotation);
+        p+=sprintf(p, "\"stream_count\":%d,", streamCount);
         p+=sprintf(p, "\"stream_url\":\"%s\"", streamURL);
     }
     *p++ = '}';
-    *p++ = 0;
+    *p = 0;
+    return p;
+}
+
+// The live figures (bitrate, frame rate) that /status adds to the cached state
+#define STATUS_LIVE_SIZE 160
+
+static char * status_live_json(char * p) {
+    float fps, fpsTarget;
+    streamGetFps(&fps, &fpsTarget);
+    p = abrStatus(p);
+    p+=sprintf(p, "\"stream_fps\":%.1f,", fps);
+    p+=sprintf(p, "\"stream_fps_target\":%.1f", fpsTarget);
+    return p;
+}
+
+// The ETag is the state version plus a hash of the live figures, which only change while streaming
+static void status_etag(char * etag, size_t size, uint32_t version, const char * live, bool cbor) {
+    uint32_t hash = 2166136261u;
+    while (*live) hash = (hash ^ (uint8_t)*live++) * 16777619u;
+    snprintf(etag, size, "\"%u-%08x%s\"", version, hash, cbor ? "-c" : "");
+}
+
+// The whole /status object as CBOR, straight from the settings table; 0 if it does not fit
+#define STATUS_CBOR_SIZE 768
+
+static size_t status_cbor(uint8_t * buf, size_t size) {
+    cbor_writer_t w;
+    cborWriterInit(&w, buf, size);
+    cborMapStart(&w);
+    if (critERR.length() == 0) {
+        int kbps, busy;
+        const char * action;
+        float fps, fpsTarget;
+        abrGetStatus(&kbps, &busy, &action);
+        streamGetFps(&fps, &fpsTarget);
+        settingsCbor(&w);
+        cborText(&w, "cam_name");
+        cborText(&w, myName);
+        cborText(&w, "code_ver");
+        cborText(&w, myVer);
+        cborText(&w, "stream_count");
+        cborInt(&w, streamCount);
+        cborText(&w, "stream_url");
+        cborText(&w, streamURL);
+        cborText(&w, "abr_kbps");
+        cborInt(&w, kbps);
+        cborText(&w, "abr_busy");
+        cborInt(&w, busy);
+        cborText(&w, "abr_action");
+        cborText(&w, action);
+        cborText(&w, "stream_fps");
+        cborFloat(&w, fps);
+        cborText(&w, "stream_fps_target");
+        cborFloat(&w, fpsTarget);
+    }
+    cborMapEnd(&w);
+    return w.overflow ? 0 : w.len;
+}
+
+static esp_err_t status_handler(httpd_req_t *req){
+    char live[STATUS_LIVE_SIZE];
+    char etag[24];
+    char match[64];
+    char query[64];
+    char value[12];
+
+    // Long poll for the changes since a version
+    if ((httpd_req_get_url_query_str(req, query, sizeof(query)) == ESP_OK) &&
+        (httpd_query_key_value(query, "since", value, sizeof(value)) == ESP_OK)) {
+        uint32_t since = strtoul(value, NULL, 10);
+        uint32_t timeout = 0;
+        if (httpd_query_key_value(query, "timeout", value, sizeof(value)) == ESP_OK) {
+            timeout = constrain(atoi(value), 0, STATUS_POLL_TIMEOUT_MAX);
+        }
+        return eventsPoll(req, since, timeout);
+    }
+
+    // Answer a poll that already has this state before building anything
+    bool cbor = wants_cbor(req);
+    uint32_t version = eventsStateVersion();
+    status_live_json(live);
+    status_etag(etag, sizeof(etag), version, live, cbor);
+    if ((httpd_req_get_hdr_value_str(req, "If-None-Match", match, sizeof(match)) == ESP_OK) && strstr(match, etag)) {
+        // Written by hand, as httpd_resp_send() always adds a Content-Type
+        char head[128];
+        int len = snprintf(head, sizeof(head), "HTTP/1.1 304 Not Modified\r\n"
+                                               "ETag: %s\r\n"
+                                               "Access-Control-Allow-Origin: *\r\n"
+                                               "\r\n", etag);
+        return (httpd_send(req, head, len) == len) ? ESP_OK : ESP_FAIL;
+    }
+    httpd_resp_set_hdr(req, "Access-Control-Allow-Origin", "*");
+    httpd_resp_set_hdr(req, "Cache-Control", "no-cache");
+    httpd_resp_set_hdr(req, "Vary", "Accept");
+
+    if (cbor) {
+        uint8_t * buf = (uint8_t*)malloc(STATUS_CBOR_SIZE);
+        if (!buf) return httpd_resp_send_500(req);
+        size_t len = status_cbor(buf, STATUS_CBOR_SIZE);
+        snprintf(value, sizeof(value), "%u", version);
+        httpd_resp_set_type(req, CBOR_TYPE);
+        httpd_resp_set_hdr(req, "ETag", etag);
+        httpd_resp_set_hdr(req, "X-Status-Version", value);
+        esp_err_t res = len ? httpd_resp_send(req, (const char *)buf, len) : httpd_resp_send_500(req);
+        free(buf);
+        return res;
+    }
+
+    char * json = (char*)malloc(EVENTS_JSON_SIZE + STATUS_LIVE_SIZE);
+    if (!json) return httpd_resp_send_500(req);
+    size_t len;
+    version = eventsState(json, &len);
+    status_etag(etag, sizeof(etag), version, live, false);
+    snprintf(value, sizeof(value), "%u", version);
+    if (len > 2) {
+        // Swap the closing brace for the live figures
+        json[len - 1] = ',';
+        len = stpcpy(json + len, live) - json;
+        json[len++] = '}';
+        json[len] = 0;
+    }
+    httpd_resp_set_type(req, "application/json");
+    httpd_resp_set_hdr(req, "ETag", etag);
+    httpd_resp_set_hdr(req, "X-Status-Version", value);
+    esp_err_t res = httpd_resp_send(req, json, len);
+    free(json);
+    return res;
+}
+
+static esp_err_t events_handler(httpd_req_t *req){
+    return eventsStartClient(req);
+}
+
+static esp_err_t capabilities_handler(httpd_req_t *req){
     httpd_resp_set_type(req, "application/json");
     httpd_resp_set_hdr(req, "Access-Control-Allow-Origin", "*");
-    return httpd_resp_send(req, json_response, strlen(json_response));
+    return settingsCapabilities(req);
+}
+
+static esp_err_t metrics_handler(httpd_req_t *req){
+    httpd_resp_set_type(req, "text/plain; version=0.0.4");
+    httpd_resp_set_hdr(req, "Access-Control-Allow-Origin", "*");
+    return metricsWrite(req);
 }
 
 static esp_err_t info_handler(httpd_req_t *req){
-    static char json_response[256];
+    char json_response[256];
+    if (wants_cbor(req)) {
+        cbor_writer_t w;
+        cborWriterInit(&w, (uint8_t *)json_response, sizeof(json_response));
+        cborMapStart(&w);
+        cborText(&w, "cam_name");
+        cborText(&w, myName);
+        cborText(&w, "rotate");
+        cborInt(&w, myRotation);
+        cborText(&w, "stream_url");
+        cborText(&w, streamURL);
+        cborMapEnd(&w);
+        httpd_resp_set_type(req, CBOR_TYPE);
+        httpd_resp_set_hdr(req, "Access-Control-Allow-Origin", "*");
+        httpd_resp_set_hdr(req, "Vary", "Accept");
+        return httpd_resp_send(req, json_response, w.len);
+    }
     char * p = json_response;
     *p++ = '{';
     p+=sprintf(p, "\"cam_name\":\"%s\",", myName);
@@ -546,10 +863,10 @@ static esp_err_t logo_svg_handler(httpd_req_t *req){
 }
 
 static esp_err_t dump_handler(httpd_req_t *req){
-    flashLED(75);
+    ledFlash(75);
     Serial.println("\r\nDump requested via Web");
     serialDump();
-    static char dumpOut[2000] = "";
+    static char dumpOut[2400] = "";
     char * d = dumpOut;
     // Header
     d+= sprintf(d,"<html><head><meta charset=\"utf-8\">\n");
@@ -620,6 +937,14 @@ static esp_err_t dump_handler(httpd_req_t *req){
 
     d+= sprintf(d,"Up: %" PRId64 ":%02i:%02i:%02i (d:h:m:s)<br>\n", upDays, upHours, upMin, upSec);
     d+= sprintf(d,"Active streams: %i, Previous streams: %lu, Images captured: %lu<br>\n", streamCount, streamsServed, imagesServed);
+    d+= sprintf(d,"Frames captured: %u, dropped: %u<br>\n", frameRingSeq(), frameRingDropped());
+    stream_stats_t stats[MAX_STREAMS];
+    int clients = streamGetStats(stats, MAX_STREAMS);
+    for (int i = 0; i < clients; i++) {
+        d+= sprintf(d,"Stream %i%s: sent %u, dropped %u, skipped %u, pending %uB, %.1f fps (target %.1f)<br>\n", stats[i].fd,
+            stats[i].ws ? " (ws)" : stats[i].raw ? " (raw)" : "", stats[i].frames, stats[i].dropped, stats[i].skipped, (uint32_t)stats[i].pending,
+            stats[i].fps, stats[i].fpsTarget);
+    }
     d+= sprintf(d,"CPU Freq: %i MHz, Xclk Freq: %i MHz<br>\n", ESP.getCpuFreqMHz(), xclk);
     d+= sprintf(d,"<span title=\"NOTE: Internal temperature sensor readings can be innacurate on the ESP32-c1 chipset, and may vary significantly between devices!\">");
     d+= sprintf(d,"MCU temperature : %i &deg;C, %i &deg;F</span>\n<br>", McuTc, McuTf);
@@ -654,9 +979,9 @@ static esp_err_t dump_handler(httpd_req_t *req){
 }
 
 static esp_err_t stop_handler(httpd_req_t *req){
-    flashLED(75);
+    ledFlash(75);
     Serial.println("\r\nStream stop requested via Web");
-    streamKill = true;
+    streamStopAll();
     httpd_resp_set_hdr(req, "Access-Control-Allow-Origin", "*");
     return httpd_resp_send(req, NULL, 0);
 }
@@ -669,7 +994,7 @@ static esp_err_t style_handler(httpd_req_t *req){
 }
 
 static esp_err_t streamviewer_handler(httpd_req_t *req){
-    flashLED(75);
+    ledFlash(75);
     Serial.println("Stream viewer requested");
     httpd_resp_set_type(req, "text/html");
     httpd_resp_set_hdr(req, "Content-Encoding", "identity");
@@ -677,7 +1002,7 @@ static esp_err_t streamviewer_handler(httpd_req_t *req){
 }
 
 static esp_err_t error_handler(httpd_req_t *req){
-    flashLED(75);
+    ledFlash(75);
     Serial.println("Sending error page");
     std::string s(error_html);
     size_t index;
@@ -697,7 +1022,7 @@ static esp_err_t index_handler(httpd_req_t *req){
     size_t buf_len;
     char view[32] = {0,};
 
-    flashLED(75);
+    ledFlash(75);
     // See if we have a specific target (full/simple/portal) and serve as appropriate
     buf_len = httpd_req_get_url_query_len(req) + 1;
     if (buf_len > 1) {
@@ -765,9 +1090,17 @@ static esp_err_t index_handler(httpd_req_t *req){
     }
 }
 
+// Each server also has a listening and a control socket
+static_assert(MAX_EVENT_CLIENTS + MAX_STATUS_POLLERS <= WEB_MAX_SOCKETS - WEB_REQUEST_SOCKETS, "events and polls would crowd out requests");
+static_assert(MAX_STATUS_POLLERS > 0, "no sockets left for long polls");
+#ifdef CONFIG_LWIP_MAX_SOCKETS
+static_assert(WEB_MAX_SOCKETS + STREAM_MAX_SOCKETS + 4 <= CONFIG_LWIP_MAX_SOCKETS, "more sockets than lwIP has");
+#endif
+
 void startCameraServer(int hPort, int sPort){
     httpd_config_t config = HTTPD_DEFAULT_CONFIG();
     config.max_uri_handlers = 16; // we use more than the default 8 (on port 80)
+    config.max_open_sockets = WEB_MAX_SOCKETS;
 
     httpd_uri_t index_uri = {
         .uri       = "/",
@@ -781,6 +1114,18 @@ void startCameraServer(int hPort, int sPort){
         .handler   = status_handler,
         .user_ctx  = NULL
     };
+    httpd_uri_t cmd_post_uri = {
+        .uri       = "/control",
+        .method    = HTTP_POST,
+        .handler   = cmd_post_handler,
+        .user_ctx  = NULL
+    };
+    httpd_uri_t capabilities_uri = {
+        .uri       = "/capabilities",
+        .method    = HTTP_GET,
+        .handler   = capabilities_handler,
+        .user_ctx  = NULL
+    };
     httpd_uri_t cmd_uri = {
         .uri       = "/control",
         .method    = HTTP_GET,
@@ -829,6 +1174,18 @@ void startCameraServer(int hPort, int sPort){
         .handler   = dump_handler,
         .user_ctx  = NULL
     };
+    httpd_uri_t metrics_uri = {
+        .uri       = "/metrics",
+        .method    = HTTP_GET,
+        .handler   = metrics_handler,
+        .user_ctx  = NULL
+    };
+    httpd_uri_t events_uri = {
+        .uri       = "/events",
+        .method    = HTTP_GET,
+        .handler   = events_handler,
+        .user_ctx  = NULL
+    };
     httpd_uri_t stop_uri = {
         .uri       = "/stop",
         .method    = HTTP_GET,
@@ -841,6 +1198,16 @@ void startCameraServer(int hPort, int sPort){
         .handler   = stream_handler,
         .user_ctx  = NULL
     };
+#ifdef CONFIG_HTTPD_WS_SUPPORT
+    httpd_uri_t ws_uri = {
+        .uri       = "/ws",
+        .method    = HTTP_GET,
+        .handler   = streamWsHandler,
+        .user_ctx  = NULL,
+        .is_websocket = true,
+        .handle_ws_control_frames = true
+    };
+#endif
     httpd_uri_t streamviewer_uri = {
         .uri       = "/view",
         .method    = HTTP_GET,
@@ -866,6 +1233,31 @@ void startCameraServer(int hPort, int sPort){
         .user_ctx  = NULL
     };
 
+    // Count and time requests to every handler for /metrics
+    metricsWrap(&index_uri, "index");
+    metricsWrap(&status_uri, "status");
+    metricsWrap(&cmd_uri, "control");
+    metricsWrap(&cmd_post_uri, "control_post");
+    metricsWrap(&capabilities_uri, "capabilities");
+    metricsWrap(&capture_uri, "capture");
+    metricsWrap(&style_uri, "style");
+    metricsWrap(&favicon_16x16_uri, "favicon_16x16");
+    metricsWrap(&favicon_32x32_uri, "favicon_32x32");
+    metricsWrap(&favicon_ico_uri, "favicon_ico");
+    metricsWrap(&logo_svg_uri, "logo");
+    metricsWrap(&dump_uri, "dump");
+    metricsWrap(&stop_uri, "stop");
+    metricsWrap(&metrics_uri, "metrics");
+    metricsWrap(&events_uri, "events");
+    metricsWrap(&stream_uri, "stream");
+#ifdef CONFIG_HTTPD_WS_SUPPORT
+    metricsWrap(&ws_uri, "ws");
+#endif
+    metricsWrap(&streamviewer_uri, "view");
+    metricsWrap(&info_uri, "info");
+    metricsWrap(&error_uri, "error");
+    metricsWrap(&viewerror_uri, "error");
+
     // Request Handlers; config.max_uri_handlers (above) must be >= the number of handlers
     config.server_port = hPort;
     config.ctrl_port = hPort;
@@ -876,8 +1268,11 @@ void startCameraServer(int hPort, int sPort){
         } else {
             httpd_register_uri_handler(camera_httpd, &index_uri);
             httpd_register_uri_handler(camera_httpd, &cmd_uri);
+            httpd_register_uri_handler(camera_httpd, &cmd_post_uri);
             httpd_register_uri_handler(camera_httpd, &status_uri);
+            httpd_register_uri_handler(camera_httpd, &capabilities_uri);
             httpd_register_uri_handler(camera_httpd, &capture_uri);
+            httpd_register_uri_handler(camera_httpd, &events_uri);
         }
         httpd_register_uri_handler(camera_httpd, &style_uri);
         httpd_register_uri_handler(camera_httpd, &favicon_16x16_uri);
@@ -886,10 +1281,20 @@ void startCameraServer(int hPort, int sPort){
         httpd_register_uri_handler(camera_httpd, &logo_svg_uri);
         httpd_register_uri_handler(camera_httpd, &dump_uri);
         httpd_register_uri_handler(camera_httpd, &stop_uri);
+        httpd_register_uri_handler(camera_httpd, &metrics_uri);
+    }
+
+    // Stream clients are served by their own tasks, see stream.cpp; events subscribers likewise, see events.cpp.
+    // Settings and lamp changes are made by the control task, see control.cpp
+    if (critERR.length() == 0) {
+        streamInit();
+        eventsInit();
+        controlInit();
     }
 
     config.server_port = sPort;
     config.ctrl_port = sPort;
+    config.max_open_sockets = STREAM_MAX_SOCKETS;
     Serial.printf("Starting stream server on port: '%d'\r\n", config.server_port);
     if (httpd_start(&stream_httpd, &config) == ESP_OK) {
         if (critERR.length() > 0) {
@@ -897,6 +1302,9 @@ void startCameraServer(int hPort, int sPort){
             httpd_register_uri_handler(camera_httpd, &viewerror_uri);
         } else {
             httpd_register_uri_handler(stream_httpd, &stream_uri);
+#ifdef CONFIG_HTTPD_WS_SUPPORT
+            httpd_register_uri_handler(stream_httpd, &ws_uri);
+#endif
             httpd_register_uri_handler(stream_httpd, &info_uri);
             httpd_register_uri_handler(stream_httpd, &streamviewer_uri);
         }
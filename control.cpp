@@ -0,0 +1,116 @@
+//
+// Sensor and lamp control task; see control.h
+//
+
+#include <Arduino.h>
+
+#include "control.h"
+#include "lamp.h"
+#include "stream.h"
+
+#define CONTROL_SETTINGS 0
+#define CONTROL_LAMP     1
+#define CONTROL_CALL     2
+
+typedef struct {
+    uint8_t type;
+    control_change_t * changes;         // CONTROL_SETTINGS: applied in order
+    int count;
+    SemaphoreHandle_t done;             // given once they are all applied, or the call has returned
+    int lamp;                           // CONTROL_LAMP
+    uint32_t fadeTime;
+    void (*fn)(void *);                 // CONTROL_CALL; NULL just waits for the queue to drain
+    void * arg;
+} control_cmd_t;
+
+static QueueHandle_t controlQueue = NULL;
+static TaskHandle_t controlTask = NULL;
+
+// Apply a group of settings between two frames; capture is only held off if a sensor register will change
+static int apply_settings(control_change_t * changes, int count) {
+    bool pause = false;
+    for (int i = 0; i < count; i++) {
+        if ((changes[i].setting->flags & SETTING_SENSOR) && !settingCurrent(changes[i].setting, changes[i].value)) pause = true;
+    }
+    if (pause) streamPauseCapture();
+    int failed = 0;
+    for (int i = 0; i < count; i++) {
+        changes[i].result = settingSet(changes[i].setting, changes[i].value);
+        if (changes[i].result != 0) failed++;
+    }
+    if (pause) streamResumeCapture();
+    return failed;
+}
+
+static void control_task(void * arg) {
+    control_cmd_t cmd;
+    while (true) {
+        if (xQueueReceive(controlQueue, &cmd, portMAX_DELAY) != pdTRUE) continue;
+        if (cmd.type == CONTROL_LAMP) {
+            lampWrite(cmd.lamp, cmd.fadeTime);
+        } else if (cmd.type == CONTROL_CALL) {
+            if (cmd.fn) cmd.fn(cmd.arg);
+            xSemaphoreGive(cmd.done);
+        } else {
+            apply_settings(cmd.changes, cmd.count);
+            xSemaphoreGive(cmd.done);
+        }
+    }
+}
+
+// Changes are made directly before the task starts, and by the task itself (eg a setting that moves the lamp)
+static bool direct() {
+    return !controlTask || (xTaskGetCurrentTaskHandle() == controlTask);
+}
+
+void controlInit() {
+    if (controlTask) return;
+    controlQueue = xQueueCreate(CONTROL_QUEUE_LENGTH, sizeof(control_cmd_t));
+    xTaskCreate(control_task, "control", 4096, NULL, 5, &controlTask);
+}
+
+// Apply 'changes' in order, as one group between two frames, and wait for them; returns how many failed
+int controlApply(control_change_t * changes, int count) {
+    if (direct()) return apply_settings(changes, count);
+    control_cmd_t cmd = { CONTROL_SETTINGS, changes, count, xSemaphoreCreateBinary(), 0, 0, NULL, NULL };
+    if (!cmd.done) {
+        for (int i = 0; i < count; i++) changes[i].result = -1;
+        return count;
+    }
+    xQueueSend(controlQueue, &cmd, portMAX_DELAY);
+    xSemaphoreTake(cmd.done, portMAX_DELAY);
+    vSemaphoreDelete(cmd.done);
+    int failed = 0;
+    for (int i = 0; i < count; i++) {
+        if (changes[i].result != 0) failed++;
+    }
+    return failed;
+}
+
+// Set the lamp to 'percent' over 'fadeTime' ms, after any changes already queued
+void controlLamp(int percent, uint32_t fadeTime) {
+    if (direct()) {
+        lampWrite(percent, fadeTime);
+        return;
+    }
+    control_cmd_t cmd = { CONTROL_LAMP, NULL, 0, NULL, percent, fadeTime, NULL, NULL };
+    xQueueSend(controlQueue, &cmd, portMAX_DELAY);
+}
+
+// Run fn(arg) on the control task, after any changes already queued, and wait for it to return
+void controlRun(void (*fn)(void *), void * arg) {
+    if (direct()) {
+        if (fn) fn(arg);
+        return;
+    }
+    control_cmd_t cmd = { CONTROL_CALL, NULL, 0, xSemaphoreCreateBinary(), 0, 0, fn, arg };
+    if (!cmd.done) return;
+    xQueueSend(controlQueue, &cmd, portMAX_DELAY);
+    xSemaphoreTake(cmd.done, portMAX_DELAY);
+    vSemaphoreDelete(cmd.done);
+}
+
+// Wait until every change queued so far has been made, eg so the lamp is known to be lit
+void controlWait() {
+    controlRun(NULL, NULL);
+}
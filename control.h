@@ -0,0 +1,35 @@
+//
+// Sensor and lamp control task.
+//
+// Every change to the sensor or the lamp is queued to one task, which makes
+// them in order. A handler that changes settings waits until they are all
+// applied and is told which failed; lamp changes are queued without waiting.
+// The task holds the capture loop off while it writes sensor registers, so
+// no frame is captured half way through a change.
+//
+// Anything else that reads or writes sensor registers (the ABR controller,
+// the exposure readings) hands that work to the task with controlRun(), so
+// the task is the only one on the sensor's SCCB bus.
+//
+// Before controlInit(), and on the control task itself, changes are made
+// straight away by the caller.
+//
+
+#pragma once
+
+#include "settings.h"
+
+// Changes that can wait in the queue; further callers block until there is room
+#define CONTROL_QUEUE_LENGTH 8
+
+typedef struct {
+    const setting_t * setting;
+    int value;
+    int result;                 // set when applied; 0 on success
+} control_change_t;
+
+extern void controlInit();
+extern int controlApply(control_change_t * changes, int count);
+extern void controlLamp(int percent, uint32_t fadeTime);
+extern void controlRun(void (*fn)(void *), void * arg);
+extern void controlWait();
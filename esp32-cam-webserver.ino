@@ -65,6 +65,19 @@ camera_config_t config;
 // used for non-volatile camera settings
 #include "storage.h"
 
+// Background status LED effects, and the illumination lamp
+#include "led.h"
+#include "lamp.h"
+
+// Sensor and lamp changes are made by one task, see control.h
+#include "control.h"
+
+// The table of settings behind /control, /status and the preferences
+#include "settings.h"
+
+// /status and /events share the cached camera state; tell them when it changes
+#include "events.h"
+
 // Sketch Info
 int sketchSize;
 int sketchSpace;
@@ -174,6 +187,24 @@ int myRotation = CAM_ROTATION;
 #endif
 int minFrameTime = MIN_FRAME_TIME;
 
+// Adaptive bitrate for the stream: 0 = off, 1 = adjust quality, 2 = quality and framesize
+#if !defined(ABR_MODE)
+    #define ABR_MODE 0
+#endif
+int abrMode = ABR_MODE;
+
+// Bitrate per stream client that the adaptive bitrate aims for, 0 = hold the frame rate instead
+#if !defined(ABR_TARGET_KBPS)
+    #define ABR_TARGET_KBPS 0
+#endif
+int abrTargetKbps = ABR_TARGET_KBPS;
+
+// While streaming, /capture returns the latest stream frame if it is no older than this (ms), 0 = always capture
+#if !defined(CAPTURE_MAX_AGE)
+    #define CAPTURE_MAX_AGE 500
+#endif
+int captureMaxAge = CAPTURE_MAX_AGE;
+
 // Illumination LAMP and status LED
 #if defined(LAMP_DISABLE)
     int lampVal = -1; // lamp is disabled in config
@@ -194,9 +225,6 @@ int minFrameTime = MIN_FRAME_TIME;
 bool autoLamp = false;         // Automatic lamp (auto on while camera running)
 
 int lampChannel = 7;           // a free PWM channel (some channels used by camera)
-const int pwmfreq = 50000;     // 50K pwm frequency
-const int pwmresolution = 9;   // duty cycle bit range
-const int pwmMax = pow(2,pwmresolution)-1;
 
 #if defined(NO_FS)
     bool filesystem = false;
@@ -286,17 +314,22 @@ void flashLED(int flashtime) {
 #endif
 }
 
-// Lamp Control
+// Lamp Control; setLamp() changes the lamp at once, fadeLamp() over LAMP_FADE_TIME ms.
+// Once the web server is running the change is queued to the control task.
 void setLamp(int newVal) {
 #if defined(LAMP_PIN)
     if (newVal != -1) {
-        // Apply a logarithmic function to the scale.
-        int brightness = round((pow(2,(1+(newVal*0.02)))-2)/6*pwmMax);
-        ledcWrite(lampChannel, brightness);
-        Serial.print("Lamp: ");
-        Serial.print(newVal);
-        Serial.print("%, pwm = ");
-        Serial.println(brightness);
+        controlLamp(newVal, 0);
+        if (debugData) Serial.printf("Lamp: %i%%, pwm = %u\r\n", newVal, lampDuty(newVal));
+    }
+#endif
+}
+
+void fadeLamp(int newVal) {
+#if defined(LAMP_PIN)
+    if (newVal != -1) {
+        controlLamp(newVal, LAMP_FADE_TIME);
+        if (debugData) Serial.printf("Lamp: fade to %i%%, pwm = %u\r\n", newVal, lampDuty(newVal));
     }
 #endif
 }
@@ -331,6 +364,7 @@ void calcURLs() {
         }
         sprintf(streamURL, "http://%d.%d.%d.%d:%d/", ip[0], ip[1], ip[2], ip[3], streamPort);
     #endif
+    eventsNotify();
 }
 
 void StartCamera() {
@@ -359,6 +393,7 @@ void StartCamera() {
     config.frame_size = FRAMESIZE_SVGA;
     config.jpeg_quality = 12;
     config.fb_location = CAMERA_FB_IN_PSRAM;
+    // Driver buffers are only held while a frame is copied into the frame ring (framering.cpp)
     config.fb_count = 2;
     config.grab_mode = CAMERA_GRAB_LATEST;
 
@@ -598,6 +633,7 @@ void setup() {
     #if defined(LED_PIN)  // If we have a notification LED, set it to output
         pinMode(LED_PIN, OUTPUT);
         digitalWrite(LED_PIN, LED_ON);
+        ledInit(LED_PIN, LED_ON, LED_OFF);
     #endif
 
     // Set up the factory reset pin as an input
@@ -619,6 +655,7 @@ void setup() {
     StartCamera();
 
     // Now load and apply any saved preferences
+    settingsInit();
     if (filesystem) {
         delay(200); // a short delay to let spi bus settle after camera init
         loadPrefs(SPIFFS);
@@ -689,6 +726,7 @@ void setup() {
                 esp_err_t err = esp_camera_deinit();
                 critERR = "<h1>OTA Has been started</h1><hr><p>Camera has Halted!</p>";
                 critERR += "<p>Wait for OTA to finish and reboot, or <a href=\"control?var=reboot&val=0\" title=\"Reboot Now (may interrupt OTA)\">reboot manually</a> to recover</p>";
+                eventsNotify();
             })
             .onEnd([]() {
                 Serial.println("\r\nEnd");
@@ -736,8 +774,7 @@ void setup() {
     // Initialise and set the lamp
     if (lampVal != -1) {
         #if defined(LAMP_PIN)
-            ledcSetup(lampChannel, pwmfreq, pwmresolution);  // configure LED PWM channel
-            ledcAttachPin(LAMP_PIN, lampChannel);            // attach the GPIO pin to the channel
+            lampInit(LAMP_PIN, lampChannel);                 // configure the PWM channel and attach the pin
             if (autoLamp) setLamp(0);                        // set default value
             else setLamp(lampVal);
          #endif
@@ -0,0 +1,402 @@
+//
+// Server-Sent Events push channel for the camera state (/events).
+//
+// A subscriber is sent the full state as soon as it connects, and again
+// each time it changes. eventsNotify() only wakes the events task, so it is
+// cheap enough to call from any handler; the task rebuilds the status JSON
+// (without the live figures, which change all the time) once per burst of
+// notifications and pushes it only if it differs from the last one sent.
+// Dashboards that used to poll /status can instead sit on one idle socket.
+//
+// The same JSON is cached for /status. Every eventsNotify() counts as a
+// change, and the JSON is rebuilt on the next read after one; its version
+// only moves on when the rebuilt JSON differs.
+//
+// Each member of the state remembers the version it last changed in, so a
+// long poll (/status?since=<version>&timeout=<ms>) can be answered with just
+// the members that changed. A poll that has to wait is handed over here like
+// a subscriber; the events task answers it when the version moves on or the
+// timeout runs out, then closes the connection.
+//
+// Like the stream, the handler sends the response headers itself and keeps
+// the socket once httpd has handed it over. Writes never block: events are
+// small, so a subscriber whose socket is full is dropped, and its browser
+// reconnects and is sent the state afresh.
+//
+
+#include <esp_http_server.h>
+#include <lwip/sockets.h>
+#include <Arduino.h>
+
+#include "events.h"
+
+// Builds the /status JSON, see app_httpd.cpp
+extern char * statusJson(char * p);
+
+// A subscriber with no event for this long (ms) is sent a comment, so dead connections are found
+#define EVENTS_KEEPALIVE 15000
+
+// Notifications arriving within this many ms of each other are sent as one event
+#define EVENTS_COALESCE 50
+
+// Most members the state object can have
+#define EVENTS_FIELDS_MAX 48
+
+static const char _EVENTS_HEADERS[] = "HTTP/1.1 200 OK\r\n"
+                                      "Content-Type: text/event-stream\r\n"
+                                      "Access-Control-Allow-Origin: *\r\n"
+                                      "Cache-Control: no-cache\r\n"
+                                      "Connection: close\r\n"
+                                      "\r\n"
+                                      "retry: 2000\n\n";
+
+typedef struct {
+    httpd_handle_t hd;
+    int fd;                       // -1 when the slot is free
+    bool failed;                  // a write failed and the session is being closed
+} events_client_t;
+
+typedef struct {
+    httpd_handle_t hd;
+    int fd;                       // -1 when the slot is free
+    uint32_t since;               // state version the poller already has
+    uint32_t deadline;            // millis() to give up waiting at
+    bool answered;                // the response is sent and the session is being closed
+} events_poller_t;
+
+typedef struct {
+    uint16_t start;               // offset of "name":value in lastState
+    uint16_t len;
+    uint32_t version;             // state version it last changed in
+} state_field_t;
+
+static events_client_t clients[MAX_EVENT_CLIENTS];
+static events_poller_t pollers[MAX_STATUS_POLLERS];
+static SemaphoreHandle_t eventsLock = NULL;   // protects everything below
+static TaskHandle_t eventsTask = NULL;
+static uint32_t changes = 1;                  // eventsNotify() calls; atomic, not under eventsLock
+static uint32_t builtChanges = 0;             // 'changes' when the state was last built
+static uint32_t stateVersion = 0;             // sent as the event id, and the /status ETag
+static char state[EVENTS_JSON_SIZE];
+static char lastState[EVENTS_JSON_SIZE];
+static size_t lastStateLen = 0;
+static char event[EVENTS_JSON_SIZE + 48];
+static size_t eventLen = 0;
+static state_field_t fields[EVENTS_FIELDS_MAX];
+static state_field_t newFields[EVENTS_FIELDS_MAX];
+static int fieldCount = 0;
+static char pollBody[EVENTS_JSON_SIZE];
+static uint32_t lastBroadcast = 0;            // millis() of the last write to the subscribers
+
+// Send all of 'buf' without waiting
+static bool send_now(int fd, const char * buf, size_t len) {
+    return lwip_send(fd, buf, len, MSG_DONTWAIT) == (ssize_t)len;
+}
+
+// Send to a subscriber, or give up on it
+static void client_send(events_client_t * client, const char * buf, size_t len) {
+    if ((client->fd < 0) || client->failed) return;
+    if (!send_now(client->fd, buf, len)) {
+        Serial.printf("Events %i dropped\r\n", client->fd);
+        client->failed = true;
+        httpd_sess_trigger_close(client->hd, client->fd);
+    }
+}
+
+static void broadcast(const char * buf, size_t len) {
+    for (int i = 0; i < MAX_EVENT_CLIENTS; i++) client_send(&clients[i], buf, len);
+    lastBroadcast = millis();
+}
+
+// Split the flat state object in 'json' into its "name":value members
+static int split_fields(const char * json, state_field_t * out) {
+    int n = 0;
+    const char * p = json + 1;
+    while (*p && (*p != '}') && (n < EVENTS_FIELDS_MAX)) {
+        const char * start = p;
+        bool quoted = false;
+        while (*p && (quoted || ((*p != ',') && (*p != '}')))) {
+            if (*p == '"') quoted = !quoted;
+            p++;
+        }
+        out[n].start = start - json;
+        out[n].len = p - start;
+        n++;
+        if (*p == ',') p++;
+    }
+    return n;
+}
+
+static size_t name_len(const char * member) {
+    return strchr(member + 1, '"') - member + 1;
+}
+
+// The version each member of 'state' last changed in, carried over from the last state where it is the same
+static void update_fields() {
+    int n = split_fields(state, newFields);
+    for (int i = 0; i < n; i++) {
+        const char * member = state + newFields[i].start;
+        newFields[i].version = stateVersion;
+        // Members keep their order, so look in the same place first
+        for (int j = 0; j < fieldCount; j++) {
+            const state_field_t * field = &fields[(i + j) % fieldCount];
+            const char * old = lastState + field->start;
+            size_t len = name_len(member);
+            if ((len == name_len(old)) && !memcmp(member, old, len)) {
+                if ((field->len == newFields[i].len) && !memcmp(member, old, field->len)) newFields[i].version = field->version;
+                break;
+            }
+        }
+    }
+    memcpy(fields, newFields, n * sizeof(state_field_t));
+    fieldCount = n;
+}
+
+// Bring the state and its event up to date; true if the state has changed since it was last built
+static bool update_event() {
+    uint32_t seen = __atomic_load_n(&changes, __ATOMIC_ACQUIRE);
+    if (seen == builtChanges) return false;
+    builtChanges = seen;
+    lastStateLen = statusJson(state) - state;
+    if (eventLen && !strcmp(state, lastState)) return false;
+    stateVersion++;
+    update_fields();
+    strcpy(lastState, state);
+    eventLen = sprintf(event, "id: %u\nevent: status\ndata: %s\n\n", stateVersion, lastState);
+    return true;
+}
+
+// The members that changed after version 'since' as a JSON object; all of them for a version from before a reboot
+static size_t poll_body(char * buf, uint32_t since) {
+    char * p = buf;
+    *p++ = '{';
+    for (int i = 0; i < fieldCount; i++) {
+        if ((since > stateVersion) || (fields[i].version > since)) {
+            if (p > buf + 1) *p++ = ',';
+            memcpy(p, lastState + fields[i].start, fields[i].len);
+            p += fields[i].len;
+        }
+    }
+    *p++ = '}';
+    *p = 0;
+    return p - buf;
+}
+
+// Answer a waiting poll with the changes, or with a 304 if there are none, and close it
+static void poller_answer(events_poller_t * poller) {
+    char head[256];
+    bool changed = (poller->since != stateVersion);
+    size_t len = changed ? poll_body(pollBody, poller->since) : 0;
+    int headLen = sprintf(head, "HTTP/1.1 %s\r\n"
+                                "Content-Type: application/json\r\n"
+                                "Access-Control-Allow-Origin: *\r\n"
+                                "Cache-Control: no-cache\r\n"
+                                "X-Status-Version: %u\r\n"
+                                "Content-Length: %u\r\n"
+                                "Connection: close\r\n"
+                                "\r\n", changed ? "200 OK" : "304 Not Modified", stateVersion, (unsigned)len);
+    if (!send_now(poller->fd, head, headLen) || (len && !send_now(poller->fd, pollBody, len))) {
+        Serial.printf("Status poll %i dropped\r\n", poller->fd);
+    }
+    poller->answered = true;
+    httpd_sess_trigger_close(poller->hd, poller->fd);
+}
+
+// Answer the polls that are due; returns the ms until the next one times out
+static uint32_t answer_pollers(uint32_t wait) {
+    uint32_t now = millis();
+    for (int i = 0; i < MAX_STATUS_POLLERS; i++) {
+        events_poller_t * poller = &pollers[i];
+        if ((poller->fd < 0) || poller->answered) continue;
+        int32_t left = (int32_t)(poller->deadline - now);
+        if ((poller->since != stateVersion) || (left <= 0)) poller_answer(poller);
+        else if ((uint32_t)left < wait) wait = left;
+    }
+    return wait;
+}
+
+static int poller_count() {
+    int n = 0;
+    for (int i = 0; i < MAX_STATUS_POLLERS; i++) {
+        if ((pollers[i].fd >= 0) && !pollers[i].answered) n++;
+    }
+    return n;
+}
+
+static int client_count() {
+    int n = 0;
+    for (int i = 0; i < MAX_EVENT_CLIENTS; i++) {
+        if ((clients[i].fd >= 0) && !clients[i].failed) n++;
+    }
+    return n;
+}
+
+static void events_task(void * arg) {
+    uint32_t wait = EVENTS_KEEPALIVE;
+    while (true) {
+        bool notified = ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(wait) + 1) > 0;
+        if (notified) {
+            // Let a burst of changes (a slider being dragged) settle into one event
+            vTaskDelay(pdMS_TO_TICKS(EVENTS_COALESCE));
+            ulTaskNotifyTake(pdTRUE, 0);
+        }
+        xSemaphoreTake(eventsLock, portMAX_DELAY);
+        bool subscribed = (client_count() > 0);
+        if (subscribed || (poller_count() > 0)) {
+            if (update_event()) broadcast(event, eventLen);
+            else if (subscribed && (millis() - lastBroadcast >= EVENTS_KEEPALIVE)) broadcast(":\n\n", 3);
+        }
+        // Wake for the next keepalive or poll timeout, whichever is sooner
+        uint32_t idle = millis() - lastBroadcast;
+        wait = (subscribed && (idle < EVENTS_KEEPALIVE)) ? EVENTS_KEEPALIVE - idle : EVENTS_KEEPALIVE;
+        wait = answer_pollers(wait);
+        xSemaphoreGive(eventsLock);
+    }
+}
+
+// Called by httpd when a subscriber's session is closed
+static void client_session_closed(void * ctx) {
+    events_client_t * client = (events_client_t *)ctx;
+    xSemaphoreTake(eventsLock, portMAX_DELAY);
+    Serial.printf("Events %i closed\r\n", client->fd);
+    client->fd = -1;
+    client->failed = false;
+    xSemaphoreGive(eventsLock);
+}
+
+// Called by httpd when a long poll's session is closed
+static void poller_session_closed(void * ctx) {
+    events_poller_t * poller = (events_poller_t *)ctx;
+    xSemaphoreTake(eventsLock, portMAX_DELAY);
+    poller->fd = -1;
+    poller->answered = false;
+    xSemaphoreGive(eventsLock);
+}
+
+void eventsInit() {
+    if (eventsLock) return;
+    for (int i = 0; i < MAX_EVENT_CLIENTS; i++) clients[i].fd = -1;
+    for (int i = 0; i < MAX_STATUS_POLLERS; i++) pollers[i].fd = -1;
+    eventsLock = xSemaphoreCreateMutex();
+    xTaskCreate(events_task, "events", 3072, NULL, 2, &eventsTask);
+}
+
+void eventsNotify() {
+    __atomic_add_fetch(&changes, 1, __ATOMIC_RELEASE);
+    if (eventsTask) xTaskNotifyGive(eventsTask);
+}
+
+// Version of the current state
+uint32_t eventsStateVersion() {
+    if (!eventsLock) return 0;
+    xSemaphoreTake(eventsLock, portMAX_DELAY);
+    if (update_event()) broadcast(event, eventLen);   // subscribers get a change as soon as anyone sees it
+    uint32_t version = stateVersion;
+    xSemaphoreGive(eventsLock);
+    return version;
+}
+
+// Copy the current state JSON into 'buf' (EVENTS_JSON_SIZE bytes) and return its version
+uint32_t eventsState(char * buf, size_t * len) {
+    if (!eventsLock) {
+        *len = statusJson(buf) - buf;
+        return 0;
+    }
+    xSemaphoreTake(eventsLock, portMAX_DELAY);
+    if (update_event()) broadcast(event, eventLen);
+    memcpy(buf, lastState, lastStateLen + 1);
+    *len = lastStateLen;
+    uint32_t version = stateVersion;
+    xSemaphoreGive(eventsLock);
+    return version;
+}
+
+esp_err_t eventsStartClient(httpd_req_t *req) {
+    xSemaphoreTake(eventsLock, portMAX_DELAY);
+    events_client_t * client = NULL;
+    for (int i = 0; i < MAX_EVENT_CLIENTS; i++) {
+        if (clients[i].fd < 0) {
+            client = &clients[i];
+            break;
+        }
+    }
+    if (!client) {
+        xSemaphoreGive(eventsLock);
+        Serial.printf("EVENTS: refused, all %i subscriber slots are in use\r\n", MAX_EVENT_CLIENTS);
+        httpd_resp_set_status(req, "503 Service Unavailable");
+        httpd_resp_set_hdr(req, "Access-Control-Allow-Origin", "*");
+        httpd_resp_send(req, NULL, 0);
+        return ESP_FAIL;
+    }
+    // Headers, then the current state; if it has changed everybody else gets it too
+    int fd = httpd_req_to_sockfd(req);
+    if (update_event()) broadcast(event, eventLen);
+    bool ok = send_now(fd, _EVENTS_HEADERS, sizeof(_EVENTS_HEADERS) - 1) && send_now(fd, event, eventLen);
+    if (ok) {
+        client->hd = req->handle;
+        client->fd = fd;
+        client->failed = false;
+    }
+    xSemaphoreGive(eventsLock);
+    if (!ok) return ESP_FAIL;
+
+    // httpd keeps the socket open and tells us when it closes
+    req->sess_ctx = client;
+    req->free_ctx = client_session_closed;
+    Serial.printf("Events %i subscribed\r\n", client->fd);
+    return ESP_OK;
+}
+
+// /status?since=<version>&timeout=<ms>: answer now if the state has moved on from 'since', else wait for it to
+esp_err_t eventsPoll(httpd_req_t *req, uint32_t since, uint32_t timeout) {
+    if (!eventsLock) return httpd_resp_send_500(req);
+    xSemaphoreTake(eventsLock, portMAX_DELAY);
+    if (update_event()) broadcast(event, eventLen);
+    if ((since != stateVersion) || (timeout == 0)) {
+        char * json = (char*)malloc(EVENTS_JSON_SIZE);
+        if (!json) {
+            xSemaphoreGive(eventsLock);
+            return httpd_resp_send_500(req);
+        }
+        size_t len = (since != stateVersion) ? poll_body(json, since) : 0;
+        char version[12];
+        snprintf(version, sizeof(version), "%u", stateVersion);
+        xSemaphoreGive(eventsLock);
+        httpd_resp_set_type(req, "application/json");
+        httpd_resp_set_hdr(req, "Access-Control-Allow-Origin", "*");
+        httpd_resp_set_hdr(req, "Cache-Control", "no-cache");
+        httpd_resp_set_hdr(req, "X-Status-Version", version);
+        if (!len) httpd_resp_set_status(req, "304 Not Modified");
+        esp_err_t res = httpd_resp_send(req, json, len);
+        free(json);
+        return res;
+    }
+
+    events_poller_t * poller = NULL;
+    for (int i = 0; i < MAX_STATUS_POLLERS; i++) {
+        if (pollers[i].fd < 0) {
+            poller = &pollers[i];
+            break;
+        }
+    }
+    if (!poller) {
+        xSemaphoreGive(eventsLock);
+        Serial.printf("STATUS: poll refused, all %i slots are in use\r\n", MAX_STATUS_POLLERS);
+        httpd_resp_set_status(req, "503 Service Unavailable");
+        httpd_resp_set_hdr(req, "Access-Control-Allow-Origin", "*");
+        httpd_resp_send(req, NULL, 0);
+        return ESP_FAIL;
+    }
+    poller->hd = req->handle;
+    poller->fd = httpd_req_to_sockfd(req);
+    poller->since = since;
+    poller->deadline = millis() + timeout;
+    poller->answered = false;
+    xSemaphoreGive(eventsLock);
+
+    // httpd keeps the socket open until the events task answers and closes it
+    req->sess_ctx = poller;
+    req->free_ctx = poller_session_closed;
+    xTaskNotifyGive(eventsTask);
+    return ESP_OK;
+}
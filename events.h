@@ -0,0 +1,38 @@
+//
+// Server-Sent Events push channel for the camera state (/events).
+//
+// Call eventsNotify() after changing anything that /status reports; the
+// subscribers are sent the new state if it really did change.
+//
+// The state JSON is also kept here for /status, rebuilt only after a change.
+// Its version goes up each time the content is different, so it can serve as
+// an ETag, and /status?since=<version> long polls wait here for it to change.
+//
+
+#pragma once
+
+#include <esp_http_server.h>
+
+// Sockets the web server (port 80) may have open. /events subscribers and
+// waiting long polls hold theirs for a long time, so their slots are limited
+// to leave WEB_REQUEST_SOCKETS for the UI, /control and /status.
+#define WEB_MAX_SOCKETS 7
+#define WEB_REQUEST_SOCKETS 3
+
+// Most /events subscribers at once; each holds a socket on the web server
+#define MAX_EVENT_CLIENTS 2
+
+// Room for the state JSON
+#define EVENTS_JSON_SIZE 1024
+
+// Most /status long polls waiting at once, and the longest wait allowed (ms);
+// with the /events slots they take what WEB_REQUEST_SOCKETS leaves
+#define MAX_STATUS_POLLERS (WEB_MAX_SOCKETS - WEB_REQUEST_SOCKETS - MAX_EVENT_CLIENTS)
+#define STATUS_POLL_TIMEOUT_MAX 30000
+
+extern void eventsInit();
+extern esp_err_t eventsStartClient(httpd_req_t *req);
+extern void eventsNotify();
+extern uint32_t eventsStateVersion();
+extern uint32_t eventsState(char * buf, size_t * len);
+extern esp_err_t eventsPoll(httpd_req_t *req, uint32_t since, uint32_t timeout);
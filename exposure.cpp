@@ -0,0 +1,88 @@
+//
+// Wait for the sensor's auto exposure to settle after the lamp comes on.
+//
+
+#include <esp_camera.h>
+#include <esp_timer.h>
+#include <Arduino.h>
+
+#include "control.h"
+#include "exposure.h"
+#include "stream.h"
+
+// These are defined in the main .ino file
+extern int sensorPID;
+extern bool debugData;
+
+typedef struct {
+    int exposure;
+    int gain;
+    bool known;                 // false if they cannot be read from this sensor
+} exposure_t;
+
+// Read the exposure time and gain the sensor is using now. Run on the control
+// task, so the reads never interleave with a register write on the SCCB bus.
+static void read_exposure(void * arg) {
+    exposure_t * e = (exposure_t *)arg;
+    sensor_t * s = esp_camera_sensor_get();
+    if (!s) return;
+    if (sensorPID == OV2640_PID) {
+        // Sensor bank (0x1xx): AEC[15:10] in REG45, AEC[9:2] in AEC, AEC[1:0] in REG04; gain in GAIN
+        int high = s->get_reg(s, 0x145, 0x3f);
+        int mid = s->get_reg(s, 0x110, 0xff);
+        int low = s->get_reg(s, 0x104, 0x03);
+        e->gain = s->get_reg(s, 0x100, 0xff);
+        if ((high < 0) || (mid < 0) || (low < 0) || (e->gain < 0)) return;
+        e->exposure = (high << 10) | (mid << 2) | low;
+        e->known = true;
+    } else if ((sensorPID == OV3660_PID) || (sensorPID == OV5640_PID)) {
+        // 20 bit exposure across 0x3500-0x3502, 10 bit gain in 0x350A-0x350B
+        e->exposure = s->get_reg(s, 0x3500, 0xfffff);
+        e->gain = s->get_reg(s, 0x350a, 0x3ff);
+        e->known = (e->exposure >= 0) && (e->gain >= 0);
+    }
+}
+
+static bool close_to(int value, int previous) {
+    return abs(value - previous) <= (previous * EXPOSURE_TOLERANCE / 100) + 1;
+}
+
+// Take frames until the exposure stops changing or 'timeout' ms pass. Returns the
+// last frame taken, held for the caller to release, or NULL if the capture failed.
+// 'settleTime' is set to the ms it took, or -1 on timeout.
+frame_t * exposureSettle(uint32_t timeout, int * settleTime) {
+    int64_t start = esp_timer_get_time();
+    exposure_t previous = { 0, 0, false };
+    size_t previousLen = 0;
+    int stable = 0;
+    int frames = 0;
+    frame_t * frame = NULL;
+    *settleTime = -1;
+
+    while (esp_timer_get_time() - start < (int64_t)timeout * 1000) {
+        if (frame) frameRingRelease(frame);
+        frame = streamGrabFrame();
+        if (!frame) break;
+        frames++;
+        exposure_t now = { 0, 0, false };
+        controlRun(read_exposure, &now);
+        bool settled;
+        if (now.known) {
+            settled = (frames > 1) && close_to(now.exposure, previous.exposure) && close_to(now.gain, previous.gain);
+            previous = now;
+        } else {
+            settled = (frames > 1) && close_to(frame->len, previousLen);
+        }
+        previousLen = frame->len;
+        stable = settled ? stable + 1 : 0;
+        if (stable >= EXPOSURE_STABLE_FRAMES) {
+            *settleTime = (int)((esp_timer_get_time() - start) / 1000);
+            break;
+        }
+    }
+    if (debugData) {
+        if (*settleTime >= 0) Serial.printf("EXPOSURE: settled in %ims, %i frames\r\n", *settleTime, frames);
+        else Serial.printf("EXPOSURE: not settled after %ims, %i frames\r\n", timeout, frames);
+    }
+    return frame;
+}
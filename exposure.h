@@ -0,0 +1,24 @@
+//
+// Wait for the sensor's auto exposure to settle after the lamp comes on.
+//
+// Frames are taken and thrown away until the exposure time and gain the
+// sensor's AEC/AGC has chosen stop changing. Sensors whose registers are not
+// known here are judged by the JPEG size instead, which tracks brightness.
+//
+
+#pragma once
+
+#include <stdint.h>
+
+#include "framering.h"
+
+// Longest time to wait for the exposure to settle (ms)
+#define EXPOSURE_SETTLE_TIMEOUT 2000
+
+// Readings may move by this much (percent) between frames and still count as settled
+#define EXPOSURE_TOLERANCE 4
+
+// Consecutive unchanged frames needed before the exposure counts as settled
+#define EXPOSURE_STABLE_FRAMES 2
+
+extern frame_t * exposureSettle(uint32_t timeout, int * settleTime);
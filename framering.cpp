@@ -0,0 +1,149 @@
+//
+// PSRAM ring of the most recently captured JPEG frames.
+//
+// The publisher copies each driver frame buffer into the oldest slot that
+// nobody is holding and hands the driver buffer straight back. Consumers
+// take a reference on a frame, read it at their own pace and release it.
+// If every slot is still referenced the new frame is dropped rather than
+// waiting, so a slow consumer can never hold up the capture.
+//
+
+#include <esp_camera.h>
+#include <esp_timer.h>
+#include <Arduino.h>
+
+#include "framering.h"
+
+// Tasks blocked in frameRingWaitNewer()
+#define FRAME_RING_WAITERS 8
+
+// Buffers grow in steps of this size to avoid reallocating on every frame
+#define FRAME_BUF_STEP 16384
+
+static frame_t ring[FRAME_RING_SIZE];
+static frame_t * latest = NULL;
+static uint32_t ringSeq = 0;
+static uint32_t ringDropped = 0;
+static TaskHandle_t waiters[FRAME_RING_WAITERS];
+static SemaphoreHandle_t ringLock = NULL;
+
+void frameRingInit() {
+    if (ringLock) return;
+    ringLock = xSemaphoreCreateMutex();
+}
+
+bool frameRingPublish(camera_fb_t * fb) {
+    // Pick the oldest slot that is not referenced
+    xSemaphoreTake(ringLock, portMAX_DELAY);
+    frame_t * frame = NULL;
+    for (int i = 0; i < FRAME_RING_SIZE; i++) {
+        frame_t * f = &ring[i];
+        if ((f->refs == 0) && !f->writing && (!frame || (f->seq < frame->seq))) {
+            frame = f;
+        }
+    }
+    if (frame) {
+        frame->writing = true;
+        frame->seq = 0;
+        if (latest == frame) latest = NULL;
+    } else {
+        ringDropped++;
+    }
+    xSemaphoreGive(ringLock);
+    if (!frame) return false;
+
+    // Copy outside the lock; nobody else can touch a slot marked as writing
+    if (frame->capacity < fb->len) {
+        size_t capacity = (fb->len + FRAME_BUF_STEP - 1) / FRAME_BUF_STEP * FRAME_BUF_STEP;
+        uint8_t * buf = (uint8_t *)ps_realloc(frame->buf, capacity);
+        if (!buf) {
+            xSemaphoreTake(ringLock, portMAX_DELAY);
+            frame->writing = false;
+            ringDropped++;
+            xSemaphoreGive(ringLock);
+            Serial.printf("FRAMES: no memory for a %uB frame\r\n", (uint32_t)fb->len);
+            return false;
+        }
+        frame->buf = buf;
+        frame->capacity = capacity;
+    }
+    memcpy(frame->buf, fb->buf, fb->len);
+    frame->len = fb->len;
+    frame->width = fb->width;
+    frame->height = fb->height;
+    frame->timestamp = (int64_t)fb->timestamp.tv_sec * 1000000 + fb->timestamp.tv_usec;
+
+    xSemaphoreTake(ringLock, portMAX_DELAY);
+    frame->seq = ++ringSeq;
+    frame->writing = false;
+    latest = frame;
+    for (int i = 0; i < FRAME_RING_WAITERS; i++) {
+        if (waiters[i]) xTaskNotifyGive(waiters[i]);
+    }
+    xSemaphoreGive(ringLock);
+    return true;
+}
+
+// Take a reference to the latest frame if it is newer than 'seq'; caller holds ringLock
+static frame_t * frame_get_newer(uint32_t seq) {
+    if (latest && (latest->seq > seq)) {
+        latest->refs++;
+        return latest;
+    }
+    return NULL;
+}
+
+frame_t * frameRingLatest() {
+    xSemaphoreTake(ringLock, portMAX_DELAY);
+    frame_t * frame = frame_get_newer(0);
+    xSemaphoreGive(ringLock);
+    return frame;
+}
+
+// Wait up to 'wait' ticks for a frame newer than 'seq'. This can return
+// NULL early if the calling task is notified for some other reason.
+frame_t * frameRingWaitNewer(uint32_t seq, TickType_t wait) {
+    TaskHandle_t self = xTaskGetCurrentTaskHandle();
+    int slot = -1;
+    xSemaphoreTake(ringLock, portMAX_DELAY);
+    frame_t * frame = frame_get_newer(seq);
+    if (!frame) {
+        for (int i = 0; i < FRAME_RING_WAITERS; i++) {
+            if (waiters[i] == NULL) {
+                waiters[i] = self;
+                slot = i;
+                break;
+            }
+        }
+    }
+    xSemaphoreGive(ringLock);
+    if (frame) return frame;
+
+    if (slot >= 0) {
+        ulTaskNotifyTake(pdTRUE, wait);
+    } else {
+        // Too many waiters; fall back to polling
+        vTaskDelay(pdMS_TO_TICKS(10));
+    }
+
+    xSemaphoreTake(ringLock, portMAX_DELAY);
+    if (slot >= 0) waiters[slot] = NULL;
+    frame = frame_get_newer(seq);
+    xSemaphoreGive(ringLock);
+    return frame;
+}
+
+void frameRingRelease(frame_t * frame) {
+    if (!frame) return;
+    xSemaphoreTake(ringLock, portMAX_DELAY);
+    frame->refs--;
+    xSemaphoreGive(ringLock);
+}
+
+uint32_t frameRingSeq() {
+    return ringSeq;
+}
+
+uint32_t frameRingDropped() {
+    return ringDropped;
+}
@@ -0,0 +1,36 @@
+//
+// PSRAM ring of the most recently captured JPEG frames.
+//
+// Frames are copied out of the camera driver's DMA buffers as soon as they
+// are captured, so consumers can hold on to them for as long as they need
+// without ever stalling the sensor.
+//
+
+#pragma once
+
+#include <esp_camera.h>
+#include <freertos/FreeRTOS.h>
+
+// Number of frames kept in the ring; enough for every stream client to be
+// part way through sending a frame with two slots left for the capture
+#define FRAME_RING_SIZE 6
+
+typedef struct {
+    uint8_t * buf;        // PSRAM copy of the JPEG data
+    size_t len;
+    size_t capacity;
+    size_t width;
+    size_t height;
+    uint32_t seq;         // publish sequence number, 0 = slot not valid
+    int64_t timestamp;    // capture time, esp_timer_get_time() microseconds
+    int refs;             // consumers currently holding this frame
+    bool writing;         // slot is being filled by frameRingPublish()
+} frame_t;
+
+extern void frameRingInit();
+extern bool frameRingPublish(camera_fb_t * fb);
+extern frame_t * frameRingLatest();
+extern frame_t * frameRingWaitNewer(uint32_t seq, TickType_t wait);
+extern void frameRingRelease(frame_t * frame);
+extern uint32_t frameRingSeq();
+extern uint32_t frameRingDropped();
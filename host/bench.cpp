@@ -0,0 +1,447 @@
+//
+// Load generator and stream benchmark.
+//
+// Opens a number of MJPEG stream subscribers and, alongside them, a mix of
+// /capture, /status and /control requests, then reports per-stream frame
+// rate, inter-frame jitter, time to first frame and throughput, and latency
+// percentiles for each request type, as JSON. Works the same against a board
+// or against the host build (esp32-cam-host).
+//
+//   esp32-cam-bench [-a address] [-p httpPort] [-s streamPort] [-n streams]
+//                   [-t seconds] [-r requests/s] [-q streamQuery] [-o file]
+//
+// Control requests write back the brightness the camera reported when the
+// run started, so a run leaves the camera settings as it found them.
+//
+
+#include <errno.h>
+#include <math.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Socket timeout; a stream that stalls for this long is counted as failed
+#define BENCH_TIMEOUT_S 10
+
+typedef struct {
+    const char * address;
+    int httpPort;
+    int streamPort;
+    int streams;
+    int seconds;
+    double requestRate;
+    const char * query;
+    const char * output;
+} options_t;
+
+typedef struct {
+    int frames;
+    uint64_t bytes;
+    double start;               // connect started
+    double firstFrame;          // first complete frame, or 0
+    double lastFrame;
+    std::vector<double> intervals;
+    std::string error;
+} stream_result_t;
+
+typedef struct {
+    const char * name;
+    int weight;                 // share of the request mix
+    std::vector<double> latencies;
+    int errors;
+} request_result_t;
+
+static options_t opt = { "127.0.0.1", 80, 81, 2, 10, 5, "", NULL };
+static std::atomic<bool> running(true);
+static std::mutex resultsLock;
+
+static double now() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static int connect_to(int port) {
+    struct addrinfo hints, * res;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_STREAM;
+    char service[8];
+    snprintf(service, sizeof(service), "%d", port);
+    if (getaddrinfo(opt.address, service, &hints, &res) != 0) return -1;
+    int fd = socket(res->ai_family, res->ai_socktype, res->ai_protocol);
+    if (fd >= 0) {
+        struct timeval tv = { BENCH_TIMEOUT_S, 0 };
+        setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+        setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+        int one = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+        if (connect(fd, res->ai_addr, res->ai_addrlen) < 0) {
+            close(fd);
+            fd = -1;
+        }
+    }
+    freeaddrinfo(res);
+    return fd;
+}
+
+// Reads one HTTP response from a socket, undoing chunked encoding
+class Response {
+public:
+    int status;
+    bool chunked;
+    long length;                // Content-Length, or -1 to read until close
+
+    Response(int fd) : status(0), chunked(false), length(-1), fd(fd), chunkLeft(0), done(false) {}
+
+    bool readHeaders() {
+        size_t end;
+        while ((end = buf.find("\r\n\r\n")) == std::string::npos) {
+            if (!fill()) return false;
+        }
+        std::string head = buf.substr(0, end);
+        buf.erase(0, end + 4);
+        if (sscanf(head.c_str(), "HTTP/%*d.%*d %d", &status) != 1) return false;
+        size_t p = 0;
+        while ((p = head.find("\r\n", p)) != std::string::npos) {
+            p += 2;
+            const char * line = head.c_str() + p;
+            if (!strncasecmp(line, "Content-Length:", 15)) length = atol(line + 15);
+            if (!strncasecmp(line, "Transfer-Encoding:", 18) && strstr(line, "chunked")) chunked = true;
+        }
+        if (!chunked && (length == 0)) done = true;
+        return true;
+    }
+
+    // Body bytes, up to 'max'; 0 at the end of the body, -1 on error
+    long read(char * out, size_t max) {
+        if (done) return 0;
+        if (chunked && (chunkLeft == 0)) {
+            size_t end;
+            while ((end = buf.find("\r\n")) == std::string::npos) {
+                if (!fill()) return -1;
+            }
+            if (end == 0) {
+                // The CRLF that ends the previous chunk
+                buf.erase(0, 2);
+                return read(out, max);
+            }
+            chunkLeft = strtol(buf.c_str(), NULL, 16);
+            buf.erase(0, end + 2);
+            if (chunkLeft == 0) {
+                done = true;
+                return 0;
+            }
+        }
+        if (buf.empty() && !fill()) {
+            if (!chunked && (length < 0)) {
+                done = true;
+                return 0;
+            }
+            return -1;
+        }
+        size_t n = std::min(max, buf.size());
+        if (chunked) n = std::min(n, (size_t)chunkLeft);
+        if (!chunked && (length >= 0)) n = std::min(n, (size_t)length);
+        memcpy(out, buf.data(), n);
+        buf.erase(0, n);
+        if (chunked) chunkLeft -= n;
+        if (!chunked && (length >= 0) && ((length -= n) == 0)) done = true;
+        return n;
+    }
+
+private:
+    int fd;
+    std::string buf;
+    long chunkLeft;
+    bool done;
+
+    bool fill() {
+        char tmp[16384];
+        ssize_t n;
+        do {
+            n = recv(fd, tmp, sizeof(tmp), 0);
+        } while ((n < 0) && (errno == EINTR));
+        if (n <= 0) return false;
+        buf.append(tmp, n);
+        return true;
+    }
+};
+
+static bool send_request(int fd, const char * path) {
+    char req[512];
+    int len = snprintf(req, sizeof(req), "GET %s HTTP/1.1\r\nHost: %s\r\nConnection: close\r\n\r\n", path, opt.address);
+    return send(fd, req, len, MSG_NOSIGNAL) == len;
+}
+
+// One complete request; the body is returned if 'body' is given
+static bool fetch(int port, const char * path, std::string * body) {
+    int fd = connect_to(port);
+    if (fd < 0) return false;
+    bool ok = send_request(fd, path);
+    Response res(fd);
+    ok = ok && res.readHeaders() && (res.status == 200);
+    char buf[16384];
+    long n;
+    while (ok && ((n = res.read(buf, sizeof(buf))) > 0)) {
+        if (body) body->append(buf, n);
+    }
+    ok = ok && (n == 0);
+    close(fd);
+    return ok;
+}
+
+static void stream_client(stream_result_t * result) {
+    char path[256];
+    snprintf(path, sizeof(path), "/%s%s", opt.query[0] ? "?" : "", opt.query);
+    result->start = now();
+    int fd = connect_to(opt.streamPort);
+    if (fd < 0) {
+        result->error = "connect failed";
+        return;
+    }
+    Response res(fd);
+    if (!send_request(fd, path) || !res.readHeaders()) {
+        result->error = "no response";
+        close(fd);
+        return;
+    }
+    if (res.status != 200) {
+        char error[32];
+        snprintf(error, sizeof(error), "HTTP %d", res.status);
+        result->error = error;
+        close(fd);
+        return;
+    }
+
+    // Frames are found by their part headers and skipped by Content-Length
+    std::string parts;
+    std::string rest;
+    long frameLeft = 0;
+    char buf[16384];
+    while (running) {
+        long n = res.read(buf, sizeof(buf));
+        if (n <= 0) {
+            if (running) result->error = (n == 0) ? "stream ended" : "stream stalled";
+            break;
+        }
+        result->bytes += n;
+        const char * p = buf;
+        while (n > 0) {
+            if (frameLeft > 0) {
+                long take = std::min(n, frameLeft);
+                frameLeft -= take;
+                p += take;
+                n -= take;
+                if (frameLeft > 0) break;
+                double t = now();
+                if (result->frames == 0) result->firstFrame = t;
+                else result->intervals.push_back(t - result->lastFrame);
+                result->lastFrame = t;
+                result->frames++;
+                continue;
+            }
+            parts.append(p, n);
+            n = 0;
+            size_t len = parts.find("Content-Length:");
+            if (len == std::string::npos) {
+                if (parts.size() > 1024) parts.erase(0, parts.size() - 64);
+                break;
+            }
+            size_t end = parts.find("\r\n\r\n", len);
+            if (end == std::string::npos) break;
+            frameLeft = atol(parts.c_str() + len + 15);
+            // Whatever followed the part header belongs to the frame
+            rest = parts.substr(end + 4);
+            parts.clear();
+            p = rest.data();
+            n = rest.size();
+        }
+    }
+    close(fd);
+}
+
+static int status_value(const std::string & status, const char * key) {
+    std::string field = std::string("\"") + key + "\":";
+    size_t p = status.find(field);
+    return (p == std::string::npos) ? 0 : atoi(status.c_str() + p + field.size());
+}
+
+static void request_mix(std::vector<request_result_t> * results, int brightness) {
+    int total = 0;
+    for (size_t i = 0; i < results->size(); i++) total += (*results)[i].weight;
+    unsigned seed = 1;
+    double interval = 1.0 / opt.requestRate;
+    double next = now();
+    while (running) {
+        double wait = next - now();
+        if (wait > 0) usleep((useconds_t)(wait * 1e6));
+        if (!running) break;
+        next += interval;
+
+        int pick = rand_r(&seed) % total;
+        size_t i = 0;
+        while (pick >= (*results)[i].weight) pick -= (*results)[i++].weight;
+        request_result_t & r = (*results)[i];
+        char path[64];
+        if (!strcmp(r.name, "control")) snprintf(path, sizeof(path), "/control?var=brightness&val=%d", brightness);
+        else snprintf(path, sizeof(path), "/%s", r.name);
+
+        double start = now();
+        bool ok = fetch(opt.httpPort, path, NULL);
+        double latency = now() - start;
+        std::lock_guard<std::mutex> lock(resultsLock);
+        if (ok) r.latencies.push_back(latency);
+        else r.errors++;
+    }
+}
+
+static double percentile(std::vector<double> values, double pct) {
+    if (values.empty()) return 0;
+    std::sort(values.begin(), values.end());
+    size_t i = (size_t)ceil(pct / 100 * values.size());
+    return values[std::min(values.size(), std::max(i, (size_t)1)) - 1];
+}
+
+static double mean(const std::vector<double> & values) {
+    if (values.empty()) return 0;
+    double sum = 0;
+    for (size_t i = 0; i < values.size(); i++) sum += values[i];
+    return sum / values.size();
+}
+
+static double stddev(const std::vector<double> & values) {
+    if (values.size() < 2) return 0;
+    double m = mean(values);
+    double sum = 0;
+    for (size_t i = 0; i < values.size(); i++) sum += (values[i] - m) * (values[i] - m);
+    return sqrt(sum / (values.size() - 1));
+}
+
+static void write_results(FILE * out, const std::vector<stream_result_t> & streams,
+                          const std::vector<request_result_t> & requests, double elapsed) {
+    fprintf(out, "{\n  \"address\": \"%s\",\n  \"http_port\": %d,\n  \"stream_port\": %d,\n",
+        opt.address, opt.httpPort, opt.streamPort);
+    fprintf(out, "  \"stream_query\": \"%s\",\n  \"duration_s\": %.3f,\n  \"request_rate\": %g,\n",
+        opt.query, elapsed, opt.requestRate);
+
+    double totalFps = 0;
+    double totalBytes = 0;
+    fprintf(out, "  \"streams\": [\n");
+    for (size_t i = 0; i < streams.size(); i++) {
+        const stream_result_t & s = streams[i];
+        double active = s.frames > 1 ? s.lastFrame - s.firstFrame : 0;
+        double fps = active > 0 ? (s.frames - 1) / active : 0;
+        double bytesPerSec = s.bytes / elapsed;
+        totalFps += fps;
+        totalBytes += bytesPerSec;
+        fprintf(out, "    { \"id\": %u, \"frames\": %d, \"fps\": %.2f, \"ttff_ms\": %.1f, \"bytes_per_s\": %.0f,\n",
+            (unsigned)i, s.frames, fps, s.frames ? (s.firstFrame - s.start) * 1000 : -1.0, bytesPerSec);
+        fprintf(out, "      \"interval_ms\": { \"mean\": %.2f, \"stddev\": %.2f, \"p50\": %.2f, \"p99\": %.2f, \"max\": %.2f },\n",
+            mean(s.intervals) * 1000, stddev(s.intervals) * 1000, percentile(s.intervals, 50) * 1000,
+            percentile(s.intervals, 99) * 1000, percentile(s.intervals, 100) * 1000);
+        if (s.error.empty()) fprintf(out, "      \"error\": null }%s\n", (i + 1 < streams.size()) ? "," : "");
+        else fprintf(out, "      \"error\": \"%s\" }%s\n", s.error.c_str(), (i + 1 < streams.size()) ? "," : "");
+    }
+    fprintf(out, "  ],\n");
+    fprintf(out, "  \"stream_totals\": { \"fps\": %.2f, \"bytes_per_s\": %.0f },\n", totalFps, totalBytes);
+
+    fprintf(out, "  \"requests\": {\n");
+    for (size_t i = 0; i < requests.size(); i++) {
+        const request_result_t & r = requests[i];
+        const std::vector<double> & l = r.latencies;
+        fprintf(out, "    \"%s\": { \"ok\": %u, \"errors\": %d, \"latency_ms\": { \"p50\": %.2f, \"p90\": %.2f, \"p99\": %.2f, \"max\": %.2f } }%s\n",
+            r.name, (unsigned)l.size(), r.errors, percentile(l, 50) * 1000, percentile(l, 90) * 1000,
+            percentile(l, 99) * 1000, percentile(l, 100) * 1000, (i + 1 < requests.size()) ? "," : "");
+    }
+    fprintf(out, "  }\n}\n");
+}
+
+static void usage(const char * name) {
+    fprintf(stderr, "usage: %s [-a address] [-p httpPort] [-s streamPort] [-n streams] [-t seconds] "
+        "[-r requests/s] [-q streamQuery] [-o file]\n", name);
+    exit(2);
+}
+
+static void stop(int sig) {
+    running = false;
+}
+
+int main(int argc, char ** argv) {
+    int c;
+    while ((c = getopt(argc, argv, "a:p:s:n:t:r:q:o:")) != -1) {
+        switch (c) {
+            case 'a': opt.address = optarg; break;
+            case 'p': opt.httpPort = atoi(optarg); break;
+            case 's': opt.streamPort = atoi(optarg); break;
+            case 'n': opt.streams = atoi(optarg); break;
+            case 't': opt.seconds = atoi(optarg); break;
+            case 'r': opt.requestRate = atof(optarg); break;
+            case 'q': opt.query = optarg; break;
+            case 'o': opt.output = optarg; break;
+            default: usage(argv[0]);
+        }
+    }
+    if ((opt.streams < 0) || (opt.seconds <= 0) || (opt.requestRate < 0)) usage(argv[0]);
+    signal(SIGPIPE, SIG_IGN);
+    signal(SIGINT, stop);
+
+    std::string status;
+    if (!fetch(opt.httpPort, "/status", &status)) {
+        fprintf(stderr, "Cannot read http://%s:%d/status\n", opt.address, opt.httpPort);
+        return 1;
+    }
+    int brightness = status_value(status, "brightness");
+
+    std::vector<stream_result_t> streams(opt.streams);
+    std::vector<request_result_t> requests(3);
+    requests[0].name = "status";  requests[0].weight = 5;
+    requests[1].name = "control"; requests[1].weight = 3;
+    requests[2].name = "capture"; requests[2].weight = 2;
+    for (size_t i = 0; i < requests.size(); i++) requests[i].errors = 0;
+
+    fprintf(stderr, "Benchmarking %s: %d streams, %g requests/s, %ds\n",
+        opt.address, opt.streams, opt.requestRate, opt.seconds);
+    double start = now();
+    std::vector<std::thread> threads;
+    for (int i = 0; i < opt.streams; i++) {
+        streams[i].frames = 0;
+        streams[i].bytes = 0;
+        streams[i].firstFrame = streams[i].lastFrame = 0;
+        threads.push_back(std::thread(stream_client, &streams[i]));
+    }
+    if (opt.requestRate > 0) threads.push_back(std::thread(request_mix, &requests, brightness));
+
+    while (running && (now() - start < opt.seconds)) usleep(100000);
+    running = false;
+    // Stream readers notice within one frame, or the socket timeout
+    for (size_t i = 0; i < threads.size(); i++) threads[i].join();
+    double elapsed = now() - start;
+
+    FILE * out = opt.output ? fopen(opt.output, "w") : stdout;
+    if (!out) {
+        perror(opt.output);
+        return 1;
+    }
+    write_results(out, streams, requests, elapsed);
+    if (opt.output) fclose(out);
+
+    for (size_t i = 0; i < streams.size(); i++) {
+        if (!streams[i].error.empty() || (streams[i].frames == 0)) return 1;
+    }
+    return 0;
+}
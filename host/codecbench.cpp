@@ -0,0 +1,273 @@
+//
+// JSON against CBOR for the status document.
+//
+// Fetches /status from a camera (or the host build) as JSON and as CBOR,
+// checks that both hold the same values, then times encoding and decoding
+// each form and writes the sizes and times as JSON. Decoding reads every
+// member into a flat list of name/value pairs, which is all a fleet
+// controller does with it; encoding writes the same list back out, the
+// JSON the way the firmware formats it and the CBOR with src/cbor.
+//
+//   esp32-cam-codecbench [-a address] [-p httpPort] [-n iterations] [-o file]
+//
+
+#include <netdb.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+#include <string>
+
+#include "src/cbor.h"
+
+#define FIELDS_MAX 64
+
+typedef struct {
+    const char * address;
+    int httpPort;
+    int iterations;
+    const char * output;
+} options_t;
+
+typedef struct {
+    const char * name;          // in the document; not NUL terminated
+    size_t nameLen;
+    uint8_t type;               // CBOR_INT, CBOR_FLOAT or CBOR_TEXT
+    int64_t i;
+    double f;
+    const char * text;          // in the document; not NUL terminated
+    size_t textLen;
+} field_t;
+
+typedef struct {
+    size_t bytes;
+    double encodeNs;
+    double decodeNs;
+} codec_result_t;
+
+static options_t opt = { "127.0.0.1", 80, 100000, NULL };
+
+static double now() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// GET 'path' with the given Accept header; returns the body of a 200 response
+static bool fetch(const char * path, const char * accept, std::string * body) {
+    struct addrinfo hints, * res;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_STREAM;
+    char service[8];
+    snprintf(service, sizeof(service), "%d", opt.httpPort);
+    if (getaddrinfo(opt.address, service, &hints, &res) != 0) return false;
+    int fd = socket(res->ai_family, res->ai_socktype, res->ai_protocol);
+    if ((fd >= 0) && (connect(fd, res->ai_addr, res->ai_addrlen) < 0)) {
+        close(fd);
+        fd = -1;
+    }
+    freeaddrinfo(res);
+    if (fd < 0) return false;
+
+    char request[256];
+    int len = snprintf(request, sizeof(request), "GET %s HTTP/1.1\r\nHost: %s\r\nAccept: %s\r\nConnection: close\r\n\r\n",
+        path, opt.address, accept);
+    // Read up to the end of the body, by Content-Length; the server may keep the connection open
+    std::string response;
+    size_t end = std::string::npos;
+    long length = -1;
+    if (send(fd, request, len, 0) == len) {
+        char buf[1024];
+        ssize_t got;
+        while ((got = recv(fd, buf, sizeof(buf), 0)) > 0) {
+            response.append(buf, got);
+            if ((end == std::string::npos) && ((end = response.find("\r\n\r\n")) != std::string::npos)) {
+                const char * header = strcasestr(response.c_str(), "\r\nContent-Length:");
+                if (header && (header < response.c_str() + end)) length = atol(header + 17);
+            }
+            if ((length >= 0) && (response.size() >= end + 4 + length)) break;
+        }
+    }
+    close(fd);
+    int status = 0;
+    if ((end == std::string::npos) || (sscanf(response.c_str(), "HTTP/%*d.%*d %d", &status) != 1) || (status != 200)) return false;
+    *body = response.substr(end + 4, (length >= 0) ? length : std::string::npos);
+    return true;
+}
+
+// Read a flat JSON object of numbers and strings, as /status is
+static int json_decode(const char * p, field_t * fields) {
+    int n = 0;
+    if (*p++ != '{') return -1;
+    while (*p == '"') {
+        if (n == FIELDS_MAX) return -1;
+        field_t * field = &fields[n++];
+        field->name = ++p;
+        while (*p != '"') p++;
+        field->nameLen = p - field->name;
+        p += 2;
+        if (*p == '"') {
+            field->type = CBOR_TEXT;
+            field->text = ++p;
+            while (*p != '"') p++;
+            field->textLen = p++ - field->text;
+        } else {
+            char * end;
+            field->i = strtoll(p, &end, 10);
+            field->type = CBOR_INT;
+            if ((*end == '.') || (*end == 'e')) {
+                field->f = strtod(p, &end);
+                field->type = CBOR_FLOAT;
+            }
+            p = end;
+        }
+        if (*p == ',') p++;
+    }
+    return (*p == '}') ? n : -1;
+}
+
+static size_t json_encode(const field_t * fields, int n, char * buf) {
+    char * p = buf;
+    *p++ = '{';
+    for (int i = 0; i < n; i++) {
+        const field_t * field = &fields[i];
+        p+=sprintf(p, "%s\"%.*s\":", i ? "," : "", (int)field->nameLen, field->name);
+        if (field->type == CBOR_TEXT) p+=sprintf(p, "\"%.*s\"", (int)field->textLen, field->text);
+        else if (field->type == CBOR_FLOAT) p+=sprintf(p, "%.1f", field->f);
+        else p+=sprintf(p, "%lld", (long long)field->i);
+    }
+    *p++ = '}';
+    *p = 0;
+    return p - buf;
+}
+
+static int cbor_decode(const uint8_t * buf, size_t len, field_t * fields) {
+    cbor_reader_t r;
+    cbor_item_t item;
+    cborReaderInit(&r, buf, len);
+    if (!cborRead(&r, &item) || (item.type != CBOR_MAP) || (item.len != CBOR_INDEFINITE)) return -1;
+    int n = 0;
+    while (cborRead(&r, &item) && (item.type == CBOR_TEXT)) {
+        if (n == FIELDS_MAX) return -1;
+        field_t * field = &fields[n++];
+        field->name = item.data;
+        field->nameLen = item.len;
+        if (!cborRead(&r, &item)) return -1;
+        field->type = item.type;
+        field->i = item.i;
+        field->f = item.f;
+        field->text = item.data;
+        field->textLen = item.len;
+    }
+    return (item.type == CBOR_BREAK) ? n : -1;
+}
+
+static size_t cbor_encode(const field_t * fields, int n, uint8_t * buf, size_t size) {
+    cbor_writer_t w;
+    cborWriterInit(&w, buf, size);
+    cborMapStart(&w);
+    for (int i = 0; i < n; i++) {
+        const field_t * field = &fields[i];
+        cborTextLen(&w, field->name, field->nameLen);
+        if (field->type == CBOR_TEXT) cborTextLen(&w, field->text, field->textLen);
+        else if (field->type == CBOR_FLOAT) cborFloat(&w, field->f);
+        else cborInt(&w, field->i);
+    }
+    cborMapEnd(&w);
+    return w.len;
+}
+
+// The CBOR document must hold the JSON one's members with the same values; quoted numbers may be plain ones
+static bool same_fields(const field_t * json, int jsonCount, const field_t * cbor, int cborCount) {
+    if (jsonCount != cborCount) return false;
+    for (int i = 0; i < jsonCount; i++) {
+        const field_t * a = &json[i];
+        const field_t * b = &cbor[i];
+        if ((a->nameLen != b->nameLen) || memcmp(a->name, b->name, a->nameLen)) return false;
+        if ((a->type == CBOR_TEXT) && (b->type == CBOR_INT)) {
+            if (strtoll(std::string(a->text, a->textLen).c_str(), NULL, 10) != b->i) return false;
+        } else if (a->type != b->type) {
+            if ((a->type != CBOR_INT) || (b->type != CBOR_FLOAT) || (a->i != (int64_t)b->f)) return false;
+        } else if (a->type == CBOR_TEXT) {
+            if ((a->textLen != b->textLen) || memcmp(a->text, b->text, a->textLen)) return false;
+        } else if (a->type == CBOR_INT) {
+            if (a->i != b->i) return false;
+        }
+    }
+    return true;
+}
+
+static void usage(const char * name) {
+    fprintf(stderr, "usage: %s [-a address] [-p httpPort] [-n iterations] [-o file]\n", name);
+    exit(2);
+}
+
+int main(int argc, char ** argv) {
+    int c;
+    while ((c = getopt(argc, argv, "a:p:n:o:")) != -1) {
+        switch (c) {
+            case 'a': opt.address = optarg; break;
+            case 'p': opt.httpPort = atoi(optarg); break;
+            case 'n': opt.iterations = atoi(optarg); break;
+            case 'o': opt.output = optarg; break;
+            default: usage(argv[0]);
+        }
+    }
+    if (opt.iterations <= 0) usage(argv[0]);
+
+    std::string json, cbor;
+    if (!fetch("/status", "application/json", &json) || !fetch("/status", "application/cbor", &cbor)) {
+        fprintf(stderr, "Cannot read http://%s:%d/status\n", opt.address, opt.httpPort);
+        return 1;
+    }
+    field_t jsonFields[FIELDS_MAX], cborFields[FIELDS_MAX];
+    int jsonCount = json_decode(json.c_str(), jsonFields);
+    int cborCount = cbor_decode((const uint8_t *)cbor.data(), cbor.size(), cborFields);
+    if ((jsonCount < 0) || (cborCount < 0)) {
+        fprintf(stderr, "Cannot decode the %s status\n", (jsonCount < 0) ? "JSON" : "CBOR");
+        return 1;
+    }
+    if (!same_fields(jsonFields, jsonCount, cborFields, cborCount)) {
+        fprintf(stderr, "The JSON and CBOR status differ\n");
+        return 1;
+    }
+
+    codec_result_t results[2];
+    field_t fields[FIELDS_MAX];
+    char out[4096];
+    size_t sink = 0;
+    double start = now();
+    for (int i = 0; i < opt.iterations; i++) sink += json_decode(json.c_str(), fields);
+    results[0].decodeNs = (now() - start) * 1e9 / opt.iterations;
+    start = now();
+    for (int i = 0; i < opt.iterations; i++) sink += json_encode(jsonFields, jsonCount, out);
+    results[0].encodeNs = (now() - start) * 1e9 / opt.iterations;
+    results[0].bytes = json.size();
+
+    start = now();
+    for (int i = 0; i < opt.iterations; i++) sink += cbor_decode((const uint8_t *)cbor.data(), cbor.size(), fields);
+    results[1].decodeNs = (now() - start) * 1e9 / opt.iterations;
+    start = now();
+    for (int i = 0; i < opt.iterations; i++) sink += cbor_encode(cborFields, cborCount, (uint8_t *)out, sizeof(out));
+    results[1].encodeNs = (now() - start) * 1e9 / opt.iterations;
+    results[1].bytes = cbor.size();
+
+    FILE * f = opt.output ? fopen(opt.output, "w") : stdout;
+    if (!f) {
+        perror(opt.output);
+        return 1;
+    }
+    fprintf(f, "{\n  \"members\": %d,\n  \"iterations\": %d,\n", jsonCount, opt.iterations);
+    const char * names[2] = { "json", "cbor" };
+    for (int i = 0; i < 2; i++) {
+        fprintf(f, "  \"%s\": {\"bytes\": %zu, \"encode_ns\": %.0f, \"decode_ns\": %.0f}%s\n",
+            names[i], results[i].bytes, results[i].encodeNs, results[i].decodeNs, i ? "" : ",");
+    }
+    fprintf(f, "}\n");
+    if (opt.output) fclose(f);
+    return (sink == 0);
+}
@@ -0,0 +1,73 @@
+//
+// Host build: the parts of the Arduino-ESP32 core used by the sketch.
+//
+
+#pragma once
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <inttypes.h>
+#include <time.h>
+#include <algorithm>
+
+#include "esp_err.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "freertos/queue.h"
+#include "driver/ledc.h"
+#include "WString.h"
+#include "IPAddress.h"
+#include "HardwareSerial.h"
+#include "Esp.h"
+
+using std::min;
+using std::max;
+
+typedef uint8_t byte;
+typedef bool boolean;
+
+#define PROGMEM
+#define F(s) (s)
+
+#define INPUT        0x01
+#define OUTPUT       0x03
+#define INPUT_PULLUP 0x05
+#define LOW          0x0
+#define HIGH         0x1
+
+#define constrain(amt,low,high) ((amt)<(low)?(low):((amt)>(high)?(high):(amt)))
+
+extern void delay(uint32_t ms);
+extern void delayMicroseconds(uint32_t us);
+extern unsigned long millis();
+extern unsigned long micros();
+
+extern void pinMode(uint8_t pin, uint8_t mode);
+extern void digitalWrite(uint8_t pin, uint8_t val);
+extern int digitalRead(uint8_t pin);
+
+extern double ledcSetup(uint8_t channel, double freq, uint8_t resolution_bits);
+extern void ledcAttachPin(uint8_t pin, uint8_t channel);
+extern void ledcWrite(uint8_t channel, uint32_t duty);
+
+extern bool psramFound();
+extern void * ps_malloc(size_t size);
+extern void * ps_calloc(size_t n, size_t size);
+extern void * ps_realloc(void * ptr, size_t size);
+
+extern bool getLocalTime(struct tm * info, uint32_t ms = 5000);
+extern void configTime(long gmtOffset_sec, int daylightOffset_sec, const char * server1,
+                       const char * server2 = nullptr, const char * server3 = nullptr);
+
+typedef enum {
+    PERIPH_I2C0_MODULE,
+    PERIPH_I2C1_MODULE,
+} periph_module_t;
+
+extern void periph_module_disable(periph_module_t periph);
+extern void periph_module_reset(periph_module_t periph);
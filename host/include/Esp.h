@@ -0,0 +1,32 @@
+//
+// Host build: chip information and heap statistics.
+//
+// Heap figures come from the host allocator; "PSRAM" is the same heap.
+//
+
+#pragma once
+
+#include <stdint.h>
+
+#include "WString.h"
+
+class EspClass {
+public:
+    const char * getSdkVersion();
+    const char * getChipModel();
+    uint32_t getCpuFreqMHz();
+    uint32_t getHeapSize();
+    uint32_t getFreeHeap();
+    uint32_t getMinFreeHeap();
+    uint32_t getMaxAllocHeap();
+    uint32_t getPsramSize();
+    uint32_t getFreePsram();
+    uint32_t getMinFreePsram();
+    uint32_t getMaxAllocPsram();
+    uint32_t getSketchSize();
+    uint32_t getFreeSketchSpace();
+    String getSketchMD5();
+    void restart();
+};
+
+extern EspClass ESP;
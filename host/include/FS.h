@@ -0,0 +1,68 @@
+//
+// Host build: an in-memory filesystem with the Arduino FS API.
+//
+// Files live in a map for the life of the process; nothing touches the disk.
+//
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <map>
+#include <memory>
+#include <string>
+
+#include "WString.h"
+
+#define FILE_READ   "r"
+#define FILE_WRITE  "w"
+#define FILE_APPEND "a"
+
+namespace fs {
+
+typedef std::map<std::string, std::string> FileMap;
+
+class File {
+public:
+    File() : files(NULL), dir(false), pos(0), writing(false) {}
+    File(FileMap * files, const std::string & path, bool dir, bool writing);
+
+    operator bool() const { return files != NULL; }
+    const char * name() const { return path.c_str(); }
+    bool isDirectory() const { return dir; }
+    size_t size() const;
+    int available();
+    int read();
+    size_t write(const uint8_t * buf, size_t size);
+    size_t print(const char * s) { return write((const uint8_t *)s, strlen(s)); }
+    size_t print(const String & s) { return print(s.c_str()); }
+    File openNextFile();
+    void close();
+
+private:
+    FileMap * files;
+    std::string path;
+    bool dir;
+    size_t pos;                 // read offset, or index of the next entry of a directory
+    bool writing;
+    std::string data;           // contents being written, stored on close
+};
+
+class FS {
+public:
+    File open(const char * path, const char * mode = FILE_READ);
+    File open(const String & path, const char * mode = FILE_READ) { return open(path.c_str(), mode); }
+    bool exists(const char * path);
+    bool exists(const String & path) { return exists(path.c_str()); }
+    bool remove(const char * path);
+    bool remove(const String & path) { return remove(path.c_str()); }
+
+protected:
+    FileMap files;
+};
+
+}
+
+using fs::FS;
+using fs::File;
@@ -0,0 +1,41 @@
+//
+// Host build: Serial writes to stdout; nothing is ever read.
+//
+
+#pragma once
+
+#include <stdarg.h>
+#include <stdio.h>
+
+#include "WString.h"
+
+class HardwareSerial {
+public:
+    void begin(unsigned long baud) {}
+    void setDebugOutput(bool enable) {}
+    void flush() { fflush(stdout); }
+    int available() { return 0; }
+    int read() { return -1; }
+
+    size_t print(const String & s) { return fputs(s.c_str(), stdout); }
+    size_t print(const char * s) { return fputs(s, stdout); }
+    size_t print(char c) { return fputc(c, stdout) != EOF; }
+    size_t print(int n) { return printf("%d", n); }
+    size_t print(unsigned int n) { return printf("%u", n); }
+    size_t print(long n) { return printf("%ld", n); }
+    size_t print(unsigned long n) { return printf("%lu", n); }
+    size_t print(double n) { return printf("%.2f", n); }
+
+    template<typename T> size_t println(const T & value) { size_t n = print(value); return n + println(); }
+    size_t println() { return fputs("\r\n", stdout); }
+
+    size_t printf(const char * format, ...) __attribute__((format(printf, 2, 3))) {
+        va_list args;
+        va_start(args, format);
+        int n = vprintf(format, args);
+        va_end(args);
+        return (n > 0) ? n : 0;
+    }
+};
+
+extern HardwareSerial Serial;
@@ -0,0 +1,25 @@
+//
+// Host build: in-memory Preferences (NVS).
+//
+
+#pragma once
+
+#include <stddef.h>
+#include <map>
+#include <string>
+
+#include "WString.h"
+
+class Preferences {
+public:
+    bool begin(const char * name, bool readOnly = false);
+    void end();
+    bool remove(const char * key);
+    size_t putString(const char * key, const char * value);
+    size_t putString(const char * key, const String & value) { return putString(key, value.c_str()); }
+    size_t getString(const char * key, char * value, size_t maxLen);
+    String getString(const char * key, const String & defaultValue = String());
+
+private:
+    std::string space;
+};
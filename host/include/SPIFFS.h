@@ -0,0 +1,16 @@
+//
+// Host build: SPIFFS is the in-memory filesystem from FS.h.
+//
+
+#pragma once
+
+#include "FS.h"
+
+class SPIFFSFS : public fs::FS {
+public:
+    bool begin(bool formatOnFail = false) { return true; }
+    size_t totalBytes() { return 1441792; }
+    size_t usedBytes();
+};
+
+extern SPIFFSFS SPIFFS;
@@ -0,0 +1,70 @@
+//
+// Host build: Arduino String, backed by std::string.
+//
+
+#pragma once
+
+#include <stdlib.h>
+#include <string>
+
+class String {
+public:
+    String() {}
+    String(const char * str) : s(str ? str : "") {}
+    String(const std::string & str) : s(str) {}
+    explicit String(char c) : s(1, c) {}
+    explicit String(int value) : s(std::to_string(value)) {}
+    explicit String(unsigned int value) : s(std::to_string(value)) {}
+    explicit String(long value) : s(std::to_string(value)) {}
+    explicit String(unsigned long value) : s(std::to_string(value)) {}
+
+    const char * c_str() const { return s.c_str(); }
+    unsigned int length() const { return s.size(); }
+    long toInt() const { return atol(s.c_str()); }
+    float toFloat() const { return atof(s.c_str()); }
+
+    char charAt(unsigned int i) const { return (i < s.size()) ? s[i] : 0; }
+    char operator[](unsigned int i) const { return charAt(i); }
+
+    int indexOf(char c, unsigned int from = 0) const { return pos(s.find(c, from)); }
+    int indexOf(const String & str, unsigned int from = 0) const { return pos(s.find(str.s, from)); }
+    int lastIndexOf(char c) const { return pos(s.rfind(c)); }
+    bool startsWith(const String & str) const { return s.compare(0, str.s.size(), str.s) == 0; }
+    bool endsWith(const String & str) const {
+        return (s.size() >= str.s.size()) && (s.compare(s.size() - str.s.size(), str.s.size(), str.s) == 0);
+    }
+
+    String substring(unsigned int from) const { return (from < s.size()) ? String(s.substr(from)) : String(); }
+    String substring(unsigned int from, unsigned int to) const {
+        if (from > to) std::swap(from, to);
+        if (from >= s.size()) return String();
+        return String(s.substr(from, to - from));
+    }
+
+    void replace(const String & find, const String & with) {
+        if (find.s.empty()) return;
+        for (size_t at = s.find(find.s); at != std::string::npos; at = s.find(find.s, at + with.s.size())) {
+            s.replace(at, find.s.size(), with.s);
+        }
+    }
+    void trim() {
+        size_t start = s.find_first_not_of(" \t\r\n");
+        size_t end = s.find_last_not_of(" \t\r\n");
+        s = (start == std::string::npos) ? std::string() : s.substr(start, end - start + 1);
+    }
+
+    String & operator+=(const String & str) { s += str.s; return *this; }
+    String & operator+=(const char * str) { s += str; return *this; }
+    String & operator+=(char c) { s += c; return *this; }
+    String operator+(const String & str) const { return String(s + str.s); }
+    String operator+(const char * str) const { return String(s + str); }
+
+    bool operator==(const String & str) const { return s == str.s; }
+    bool operator==(const char * str) const { return s == str; }
+    bool operator!=(const String & str) const { return s != str.s; }
+    bool operator!=(const char * str) const { return s != str; }
+
+private:
+    static int pos(size_t at) { return (at == std::string::npos) ? -1 : (int)at; }
+    std::string s;
+};
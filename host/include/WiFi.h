@@ -0,0 +1,23 @@
+//
+// Host build: enough of WiFi to report on a connection that is always up.
+//
+
+#pragma once
+
+#include <stdint.h>
+
+#include "WString.h"
+#include "IPAddress.h"
+
+class WiFiClass {
+public:
+    String SSID() { return String("host"); }
+    int8_t RSSI() { return -50; }
+    String BSSIDstr() { return String("00:00:00:00:00:00"); }
+    uint8_t * macAddress(uint8_t * mac) {
+        for (int i = 0; i < 6; i++) mac[i] = 0;
+        return mac;
+    }
+};
+
+extern WiFiClass WiFi;
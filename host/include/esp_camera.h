@@ -0,0 +1,169 @@
+//
+// Host build: the esp32-camera driver API, served by a simulated sensor.
+//
+// Frames come from JPEG files in a directory, or are synthesised with a
+// size that follows framesize and quality, and are delivered at a fixed
+// sensor frame rate. See host/shim/camera.cpp.
+//
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <sys/time.h>
+
+#include "esp_err.h"
+#include "driver/ledc.h"
+
+#define OV9650_PID  0x96
+#define OV7725_PID  0x77
+#define OV2640_PID  0x26
+#define OV3660_PID  0x3660
+#define OV5640_PID  0x5640
+
+typedef enum {
+    PIXFORMAT_RGB565,
+    PIXFORMAT_YUV422,
+    PIXFORMAT_GRAYSCALE,
+    PIXFORMAT_JPEG,
+    PIXFORMAT_RGB888,
+    PIXFORMAT_RAW,
+    PIXFORMAT_RGB444,
+    PIXFORMAT_RGB555,
+} pixformat_t;
+
+typedef enum {
+    FRAMESIZE_96X96,    // 96x96
+    FRAMESIZE_QQVGA,    // 160x120
+    FRAMESIZE_QCIF,     // 176x144
+    FRAMESIZE_HQVGA,    // 240x176
+    FRAMESIZE_240X240,  // 240x240
+    FRAMESIZE_QVGA,     // 320x240
+    FRAMESIZE_CIF,      // 400x296
+    FRAMESIZE_HVGA,     // 480x320
+    FRAMESIZE_VGA,      // 640x480
+    FRAMESIZE_SVGA,     // 800x600
+    FRAMESIZE_XGA,      // 1024x768
+    FRAMESIZE_HD,       // 1280x720
+    FRAMESIZE_SXGA,     // 1280x1024
+    FRAMESIZE_UXGA,     // 1600x1200
+    FRAMESIZE_FHD,      // 1920x1080
+    FRAMESIZE_P_HD,     //  720x1280
+    FRAMESIZE_P_3MP,    //  864x1536
+    FRAMESIZE_QXGA,     // 2048x1536
+    FRAMESIZE_QHD,      // 2560x1440
+    FRAMESIZE_WQXGA,    // 2560x1600
+    FRAMESIZE_P_FHD,    // 1080x1920
+    FRAMESIZE_QSXGA,    // 2560x1920
+    FRAMESIZE_INVALID
+} framesize_t;
+
+typedef enum {
+    GAINCEILING_2X,
+    GAINCEILING_4X,
+    GAINCEILING_8X,
+    GAINCEILING_16X,
+    GAINCEILING_32X,
+    GAINCEILING_64X,
+    GAINCEILING_128X,
+} gainceiling_t;
+
+typedef struct {
+    const uint16_t width;
+    const uint16_t height;
+} resolution_info_t;
+
+extern const resolution_info_t resolution[FRAMESIZE_INVALID];
+
+typedef struct {
+    uint8_t MIDH;
+    uint8_t MIDL;
+    uint16_t PID;
+    uint8_t VER;
+} sensor_id_t;
+
+typedef struct {
+    framesize_t framesize;
+    bool scale;
+    bool binning;
+    uint8_t quality;
+    int8_t brightness;
+    int8_t contrast;
+    int8_t saturation;
+    int8_t sharpness;
+    uint8_t denoise;
+    uint8_t special_effect;
+    uint8_t wb_mode;
+    uint8_t awb;
+    uint8_t awb_gain;
+    uint8_t aec;
+    uint8_t aec2;
+    int8_t ae_level;
+    uint16_t aec_value;
+    uint8_t agc;
+    uint8_t agc_gain;
+    uint8_t gainceiling;
+    uint8_t bpc;
+    uint8_t wpc;
+    uint8_t raw_gma;
+    uint8_t lenc;
+    uint8_t hmirror;
+    uint8_t vflip;
+    uint8_t dcw;
+    uint8_t colorbar;
+} camera_status_t;
+
+typedef struct _sensor sensor_t;
+typedef struct _sensor {
+    sensor_id_t id;
+    uint8_t slv_addr;
+    pixformat_t pixformat;
+    camera_status_t status;
+    int xclk_freq_hz;
+
+    int (*init_status)(sensor_t * sensor);
+    int (*reset)(sensor_t * sensor);
+    int (*set_pixformat)(sensor_t * sensor, pixformat_t pixformat);
+    int (*set_framesize)(sensor_t * sensor, framesize_t framesize);
+    int (*set_contrast)(sensor_t * sensor, int level);
+    int (*set_brightness)(sensor_t * sensor, int level);
+    int (*set_saturation)(sensor_t * sensor, int level);
+    int (*set_sharpness)(sensor_t * sensor, int level);
+    int (*set_denoise)(sensor_t * sensor, int level);
+    int (*set_gainceiling)(sensor_t * sensor, gainceiling_t gainceiling);
+    int (*set_quality)(sensor_t * sensor, int quality);
+    int (*set_colorbar)(sensor_t * sensor, int enable);
+    int (*set_whitebal)(sensor_t * sensor, int enable);
+    int (*set_gain_ctrl)(sensor_t * sensor, int enable);
+    int (*set_exposure_ctrl)(sensor_t * sensor, int enable);
+    int (*set_hmirror)(sensor_t * sensor, int enable);
+    int (*set_vflip)(sensor_t * sensor, int enable);
+    int (*set_aec2)(sensor_t * sensor, int enable);
+    int (*set_awb_gain)(sensor_t * sensor, int enable);
+    int (*set_agc_gain)(sensor_t * sensor, int gain);
+    int (*set_aec_value)(sensor_t * sensor, int gain);
+    int (*set_special_effect)(sensor_t * sensor, int effect);
+    int (*set_wb_mode)(sensor_t * sensor, int mode);
+    int (*set_ae_level)(sensor_t * sensor, int level);
+    int (*set_dcw)(sensor_t * sensor, int enable);
+    int (*set_bpc)(sensor_t * sensor, int enable);
+    int (*set_wpc)(sensor_t * sensor, int enable);
+    int (*set_raw_gma)(sensor_t * sensor, int enable);
+    int (*set_lenc)(sensor_t * sensor, int enable);
+    int (*get_reg)(sensor_t * sensor, int reg, int mask);
+    int (*set_reg)(sensor_t * sensor, int reg, int mask, int value);
+    int (*set_xclk)(sensor_t * sensor, int timer, int xclk);
+} sensor_t;
+
+typedef struct {
+    uint8_t * buf;
+    size_t len;
+    size_t width;
+    size_t height;
+    pixformat_t format;
+    struct timeval timestamp;
+} camera_fb_t;
+
+extern camera_fb_t * esp_camera_fb_get();
+extern void esp_camera_fb_return(camera_fb_t * fb);
+extern sensor_t * esp_camera_sensor_get();
@@ -0,0 +1,183 @@
+//
+// Host build: the subset of the ESP-IDF 4.4 esp_http_server API used by the
+// sketch, over POSIX sockets. See host/shim/httpd.cpp for what is and is not
+// emulated.
+//
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <sys/types.h>
+
+#include "esp_err.h"
+
+// The Arduino core builds esp_http_server with WebSocket support
+#define CONFIG_HTTPD_WS_SUPPORT 1
+
+#define HTTPD_MAX_REQ_HDR_LEN   512
+#define HTTPD_MAX_URI_LEN       512
+#define HTTPD_RESP_USE_STRLEN   -1
+#define HTTPD_SOCK_ERR_FAIL     -1
+
+#define HTTPD_200       "200 OK"
+#define HTTPD_204       "204 No Content"
+#define HTTPD_400       "400 Bad Request"
+#define HTTPD_404       "404 Not Found"
+#define HTTPD_408       "408 Request Timeout"
+#define HTTPD_500       "500 Internal Server Error"
+
+#define HTTPD_TYPE_JSON     "application/json"
+#define HTTPD_TYPE_TEXT     "text/html"
+#define HTTPD_TYPE_OCTET    "application/octet-stream"
+
+// Same values as http_parser
+enum http_method {
+    HTTP_DELETE = 0,
+    HTTP_GET = 1,
+    HTTP_HEAD = 2,
+    HTTP_POST = 3,
+    HTTP_PUT = 4,
+    HTTP_OPTIONS = 6,
+};
+typedef enum http_method httpd_method_t;
+
+typedef enum {
+    HTTPD_500_INTERNAL_SERVER_ERROR = 0,
+    HTTPD_400_BAD_REQUEST,
+    HTTPD_404_NOT_FOUND,
+    HTTPD_408_REQ_TIMEOUT,
+} httpd_err_code_t;
+
+typedef void * httpd_handle_t;
+typedef void (*httpd_free_ctx_fn_t)(void * ctx);
+typedef void (*httpd_work_fn_t)(void * arg);
+typedef esp_err_t (*httpd_open_func_t)(httpd_handle_t hd, int sockfd);
+typedef void (*httpd_close_func_t)(httpd_handle_t hd, int sockfd);
+typedef bool (*httpd_uri_match_func_t)(const char * reference_uri, const char * uri_to_match, size_t match_upto);
+
+typedef struct httpd_req {
+    httpd_handle_t handle;
+    int method;
+    const char uri[HTTPD_MAX_URI_LEN + 1];
+    size_t content_len;
+    void * aux;
+    void * user_ctx;
+    void * sess_ctx;
+    httpd_free_ctx_fn_t free_ctx;
+    bool ignore_sess_ctx_changes;
+} httpd_req_t;
+
+typedef struct httpd_uri {
+    const char * uri;
+    httpd_method_t method;
+    esp_err_t (*handler)(httpd_req_t * r);
+    void * user_ctx;
+    bool is_websocket;
+    bool handle_ws_control_frames;
+    const char * supported_subprotocol;
+} httpd_uri_t;
+
+typedef enum {
+    HTTPD_WS_TYPE_CONTINUE = 0x0,
+    HTTPD_WS_TYPE_TEXT     = 0x1,
+    HTTPD_WS_TYPE_BINARY   = 0x2,
+    HTTPD_WS_TYPE_CLOSE    = 0x8,
+    HTTPD_WS_TYPE_PING     = 0x9,
+    HTTPD_WS_TYPE_PONG     = 0xA,
+} httpd_ws_type_t;
+
+typedef struct httpd_ws_frame {
+    bool final;
+    bool fragmented;
+    httpd_ws_type_t type;
+    uint8_t * payload;
+    size_t len;
+} httpd_ws_frame_t;
+
+typedef struct httpd_config {
+    unsigned task_priority;
+    size_t stack_size;
+    int core_id;
+    uint16_t server_port;
+    uint16_t ctrl_port;
+    uint16_t max_open_sockets;
+    uint16_t max_uri_handlers;
+    uint16_t max_resp_headers;
+    uint16_t backlog_conn;
+    bool lru_purge_enable;
+    uint16_t recv_wait_timeout;
+    uint16_t send_wait_timeout;
+    void * global_user_ctx;
+    httpd_free_ctx_fn_t global_user_ctx_free_fn;
+    void * global_transport_ctx;
+    httpd_free_ctx_fn_t global_transport_ctx_free_fn;
+    httpd_open_func_t open_fn;
+    httpd_close_func_t close_fn;
+    httpd_uri_match_func_t uri_match_fn;
+} httpd_config_t;
+
+#define HTTPD_DEFAULT_CONFIG() {                        \
+        .task_priority      = 5,                        \
+        .stack_size         = 4096,                     \
+        .core_id            = 0x7fffffff,               \
+        .server_port        = 80,                       \
+        .ctrl_port          = 32768,                    \
+        .max_open_sockets   = 7,                        \
+        .max_uri_handlers   = 8,                        \
+        .max_resp_headers   = 8,                        \
+        .backlog_conn       = 5,                        \
+        .lru_purge_enable   = false,                    \
+        .recv_wait_timeout  = 5,                        \
+        .send_wait_timeout  = 5,                        \
+        .global_user_ctx = NULL,                        \
+        .global_user_ctx_free_fn = NULL,                \
+        .global_transport_ctx = NULL,                   \
+        .global_transport_ctx_free_fn = NULL,           \
+        .open_fn = NULL,                                \
+        .close_fn = NULL,                               \
+        .uri_match_fn = NULL                            \
+}
+
+extern esp_err_t httpd_start(httpd_handle_t * handle, const httpd_config_t * config);
+extern esp_err_t httpd_stop(httpd_handle_t handle);
+extern esp_err_t httpd_register_uri_handler(httpd_handle_t handle, const httpd_uri_t * uri_handler);
+extern bool httpd_uri_match_wildcard(const char * reference_uri, const char * uri_to_match, size_t match_upto);
+
+extern size_t httpd_req_get_url_query_len(httpd_req_t * r);
+extern esp_err_t httpd_req_get_url_query_str(httpd_req_t * r, char * buf, size_t buf_len);
+extern esp_err_t httpd_query_key_value(const char * qry, const char * key, char * val, size_t val_size);
+extern size_t httpd_req_get_hdr_value_len(httpd_req_t * r, const char * field);
+extern esp_err_t httpd_req_get_hdr_value_str(httpd_req_t * r, const char * field, char * val, size_t val_size);
+extern int httpd_req_recv(httpd_req_t * r, char * buf, size_t buf_len);
+extern int httpd_req_to_sockfd(httpd_req_t * r);
+
+extern esp_err_t httpd_resp_set_status(httpd_req_t * r, const char * status);
+extern esp_err_t httpd_resp_set_type(httpd_req_t * r, const char * type);
+extern esp_err_t httpd_resp_set_hdr(httpd_req_t * r, const char * field, const char * value);
+extern esp_err_t httpd_resp_send(httpd_req_t * r, const char * buf, ssize_t buf_len);
+extern esp_err_t httpd_resp_send_chunk(httpd_req_t * r, const char * buf, ssize_t buf_len);
+extern esp_err_t httpd_resp_send_err(httpd_req_t * r, httpd_err_code_t error, const char * msg);
+extern int httpd_send(httpd_req_t * r, const char * buf, size_t buf_len);
+
+static inline esp_err_t httpd_resp_sendstr(httpd_req_t * r, const char * str) {
+    return httpd_resp_send(r, str, HTTPD_RESP_USE_STRLEN);
+}
+static inline esp_err_t httpd_resp_send_404(httpd_req_t * r) {
+    return httpd_resp_send_err(r, HTTPD_404_NOT_FOUND, NULL);
+}
+static inline esp_err_t httpd_resp_send_408(httpd_req_t * r) {
+    return httpd_resp_send_err(r, HTTPD_408_REQ_TIMEOUT, NULL);
+}
+static inline esp_err_t httpd_resp_send_500(httpd_req_t * r) {
+    return httpd_resp_send_err(r, HTTPD_500_INTERNAL_SERVER_ERROR, NULL);
+}
+
+extern esp_err_t httpd_ws_recv_frame(httpd_req_t * r, httpd_ws_frame_t * pkt, size_t max_len);
+
+extern int httpd_socket_send(httpd_handle_t hd, int sockfd, const char * buf, size_t buf_len, int flags);
+extern int httpd_socket_recv(httpd_handle_t hd, int sockfd, char * buf, size_t buf_len, int flags);
+extern esp_err_t httpd_sess_trigger_close(httpd_handle_t handle, int sockfd);
+extern void * httpd_sess_get_ctx(httpd_handle_t handle, int sockfd);
+extern void httpd_sess_set_ctx(httpd_handle_t handle, int sockfd, void * ctx, httpd_free_ctx_fn_t free_fn);
+extern esp_err_t httpd_queue_work(httpd_handle_t handle, httpd_work_fn_t work, void * arg);
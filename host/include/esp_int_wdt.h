@@ -0,0 +1,5 @@
+//
+// Host build: nothing is needed from the interrupt watchdog.
+//
+
+#pragma once
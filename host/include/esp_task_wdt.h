@@ -0,0 +1,10 @@
+//
+// Host build: the task watchdog does nothing.
+//
+
+#pragma once
+
+#include "esp_err.h"
+
+extern esp_err_t esp_task_wdt_init(uint32_t timeout, bool panic);
+extern esp_err_t esp_task_wdt_add(void * task);
@@ -0,0 +1,41 @@
+//
+// Host build: FreeRTOS on top of POSIX threads.
+//
+// One tick is one millisecond, as on the ESP32 Arduino core. Priorities and
+// core affinity are accepted and ignored.
+//
+
+#pragma once
+
+#include <stdint.h>
+#include <pthread.h>
+
+typedef uint32_t TickType_t;
+typedef int BaseType_t;
+typedef unsigned int UBaseType_t;
+
+#define pdFALSE         0
+#define pdTRUE          1
+#define pdPASS          pdTRUE
+#define pdFAIL          pdFALSE
+#define errQUEUE_EMPTY  0
+#define errQUEUE_FULL   0
+
+#define portMAX_DELAY           ((TickType_t)0xffffffffUL)
+#define portTICK_PERIOD_MS      1
+#define configTICK_RATE_HZ      1000
+#define configMAX_PRIORITIES    25
+#define tskIDLE_PRIORITY        0
+#define tskNO_AFFINITY          0x7fffffff
+#define pdMS_TO_TICKS(ms)       ((TickType_t)(ms))
+
+// Critical sections are a plain mutex; nothing nests them
+typedef struct {
+    pthread_mutex_t mutex;
+} portMUX_TYPE;
+
+#define portMUX_INITIALIZER_UNLOCKED    { PTHREAD_MUTEX_INITIALIZER }
+#define portENTER_CRITICAL(mux)         pthread_mutex_lock(&(mux)->mutex)
+#define portEXIT_CRITICAL(mux)          pthread_mutex_unlock(&(mux)->mutex)
+#define portENTER_CRITICAL_ISR(mux)     portENTER_CRITICAL(mux)
+#define portEXIT_CRITICAL_ISR(mux)      portEXIT_CRITICAL(mux)
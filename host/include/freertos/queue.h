@@ -0,0 +1,17 @@
+//
+// Host build: FreeRTOS queues, copying fixed size items.
+//
+
+#pragma once
+
+#include "FreeRTOS.h"
+
+typedef struct host_queue * QueueHandle_t;
+
+extern QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t itemSize);
+extern BaseType_t xQueueSend(QueueHandle_t queue, const void * item, TickType_t wait);
+extern BaseType_t xQueueReceive(QueueHandle_t queue, void * item, TickType_t wait);
+extern UBaseType_t uxQueueMessagesWaiting(QueueHandle_t queue);
+extern void vQueueDelete(QueueHandle_t queue);
+
+#define xQueueSendToBack(queue, item, wait) xQueueSend((queue), (item), (wait))
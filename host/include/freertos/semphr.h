@@ -0,0 +1,18 @@
+//
+// Host build: FreeRTOS semaphores. Mutexes are binary semaphores that start
+// out available; like the real thing they are not recursive.
+//
+
+#pragma once
+
+#include "FreeRTOS.h"
+
+typedef struct host_semaphore * SemaphoreHandle_t;
+
+extern SemaphoreHandle_t xSemaphoreCreateCounting(UBaseType_t max, UBaseType_t initial);
+extern BaseType_t xSemaphoreTake(SemaphoreHandle_t sem, TickType_t wait);
+extern BaseType_t xSemaphoreGive(SemaphoreHandle_t sem);
+extern void vSemaphoreDelete(SemaphoreHandle_t sem);
+
+#define xSemaphoreCreateMutex()     xSemaphoreCreateCounting(1, 1)
+#define xSemaphoreCreateBinary()    xSemaphoreCreateCounting(1, 0)
@@ -0,0 +1,36 @@
+//
+// Host build: FreeRTOS tasks are detached POSIX threads. Every thread,
+// including ones the shim did not start, gets a handle the first time it
+// asks for one, so task notifications work from anywhere.
+//
+
+#pragma once
+
+#include "FreeRTOS.h"
+
+typedef struct host_task * TaskHandle_t;
+typedef void (*TaskFunction_t)(void * arg);
+
+typedef enum {
+    eNoAction = 0,
+    eSetBits,
+    eIncrement,
+    eSetValueWithOverwrite,
+    eSetValueWithoutOverwrite,
+} eNotifyAction;
+
+extern BaseType_t xTaskCreate(TaskFunction_t fn, const char * name, uint32_t stack, void * arg,
+                              UBaseType_t priority, TaskHandle_t * handle);
+extern BaseType_t xTaskCreatePinnedToCore(TaskFunction_t fn, const char * name, uint32_t stack, void * arg,
+                                          UBaseType_t priority, TaskHandle_t * handle, BaseType_t core);
+extern void vTaskDelete(TaskHandle_t task);
+extern void vTaskDelay(TickType_t ticks);
+extern TickType_t xTaskGetTickCount();
+extern TaskHandle_t xTaskGetCurrentTaskHandle();
+extern const char * pcTaskGetName(TaskHandle_t task);
+
+extern BaseType_t xTaskNotify(TaskHandle_t task, uint32_t value, eNotifyAction action);
+extern BaseType_t xTaskNotifyWait(uint32_t clearOnEntry, uint32_t clearOnExit, uint32_t * value, TickType_t wait);
+extern uint32_t ulTaskNotifyTake(BaseType_t clear, TickType_t wait);
+
+#define xTaskNotifyGive(task) xTaskNotify((task), 0, eIncrement)
@@ -0,0 +1,29 @@
+//
+// Host build: lwIP socket calls map straight onto POSIX sockets.
+//
+
+#pragma once
+
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+
+#define lwip_writev   writev
+#define lwip_select   select
+#define lwip_close    close
+#define lwip_recv     recv
+#define lwip_fcntl    fcntl
+
+// Writes to a closed peer must fail rather than raise SIGPIPE
+static inline ssize_t lwip_sendmsg(int s, const struct msghdr * msg, int flags) {
+    return sendmsg(s, msg, flags | MSG_NOSIGNAL);
+}
+
+static inline ssize_t lwip_send(int s, const void * data, size_t size, int flags) {
+    return send(s, data, size, flags | MSG_NOSIGNAL);
+}
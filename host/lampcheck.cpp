@@ -0,0 +1,57 @@
+//
+// Lamp curve check.
+//
+// Runs Docs/linearled/linearled.c for every PWM resolution it accepts and
+// compares each of its 101 duty values with the compile-time curve in
+// lamp.h that builds the firmware's lamp table.
+//
+//   esp32-cam-lampcheck path/to/linearled
+//
+// The exit status is non-zero if any value differs or linearled can't be run.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "lamp.h"
+
+// Compare one resolution; returns the number of values that differ
+static int check_bits(const char * linearled, int bits) {
+    char command[512];
+    snprintf(command, sizeof(command), "%s %i", linearled, bits);
+    FILE * f = popen(command, "r");
+    if (!f) return -1;
+
+    char line[128];
+    int seen = 0;
+    int wrong = 0;
+    while (fgets(line, sizeof(line), f)) {
+        int percent, pwm;
+        if (sscanf(line, " %i : %i", &percent, &pwm) != 2) continue;
+        if ((percent < 0) || (percent > 100)) continue;
+        seen++;
+        if (lamp_pwm(percent, bits) != pwm) {
+            printf("%2i bits, %3i%%: linearled %5i, lamp.h %5i\n", bits, percent, pwm, lamp_pwm(percent, bits));
+            wrong++;
+        }
+    }
+    if ((pclose(f) != 0) || (seen != 101)) {
+        printf("%2i bits: linearled gave %i values\n", bits, seen);
+        return -1;
+    }
+    return wrong;
+}
+
+int main(int argc, char ** argv) {
+    if (argc != 2) {
+        fprintf(stderr, "usage: %s path/to/linearled\n", argv[0]);
+        return 2;
+    }
+    int failed = 0;
+    for (int bits = 2; bits <= 16; bits++) {
+        int wrong = check_bits(argv[1], bits);
+        if (wrong) failed++;
+        else printf("%2i bits: all 101 values match\n", bits);
+    }
+    return failed ? 1 : 0;
+}
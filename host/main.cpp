@@ -0,0 +1,142 @@
+//
+// Host build: stands in for esp32-cam-webserver.ino.
+//
+// Defines the globals the sketch owns, starts the simulated camera and
+// filesystem, and runs the web and stream servers until interrupted.
+//
+//   esp32-cam-host [-p httpPort] [-s streamPort] [-f framesDir] [-r fps] [-d]
+//
+
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <Arduino.h>
+#include <esp_camera.h>
+
+#include "../storage.h"
+#include "../led.h"
+#include "../lamp.h"
+#include "../control.h"
+#include "../settings.h"
+#include "../src/version.h"
+#include "shim/host.h"
+
+extern void startCameraServer(int hPort, int sPort);
+
+// Globals owned by the sketch, with the sketch's defaults
+int sketchSize = 1024 * 1024;
+int sketchSpace = 1536 * 1024;
+String sketchMD5 = "00000000000000000000000000000000";
+bool accesspoint = false;
+IPAddress ip(127, 0, 0, 1);
+IPAddress net(255, 0, 0, 0);
+IPAddress gw(127, 0, 0, 1);
+bool captivePortal = false;
+char apName[64] = "Undefined";
+char httpURL[64] = {"Undefined"};
+char streamURL[64] = {"Undefined"};
+int8_t streamCount = 0;
+unsigned long streamsServed = 0;
+unsigned long imagesServed = 0;
+char myVer[] = __DATE__ " @ " __TIME__;
+int sensorPID;
+char myName[64] = "ESP32 camera server (host)";
+int httpPort = 8080;
+int streamPort = 8081;
+char default_index[] = "full";
+unsigned long xclk = 8;
+int myRotation = 0;
+int minFrameTime = 0;
+int abrMode = 0;
+int abrTargetKbps = 0;
+int captureMaxAge = 500;
+int lampVal = 0;
+bool autoLamp = false;
+bool filesystem = true;
+bool otaEnabled = false;
+char otaPassword[] = "";
+bool haveTime = true;
+String critERR = "";
+bool debugData = false;
+
+void flashLED(int flashtime) {}
+
+void setLamp(int newVal) {
+    if (newVal == -1) return;
+    controlLamp(newVal, 0);
+    if (debugData) Serial.printf("Lamp: %i%%, pwm = %u\r\n", newVal, lampDuty(newVal));
+    hostCameraLamp(newVal);
+}
+
+void fadeLamp(int newVal) {
+    if (newVal == -1) return;
+    controlLamp(newVal, LAMP_FADE_TIME);
+    if (debugData) Serial.printf("Lamp: fade to %i%%, pwm = %u\r\n", newVal, lampDuty(newVal));
+    hostCameraLamp(newVal);
+}
+
+void printLocalTime(bool extraData) {
+    struct tm timeinfo;
+    getLocalTime(&timeinfo);
+    char buf[64];
+    strftime(buf, sizeof(buf), "%H:%M:%S, %A, %B %d %Y", &timeinfo);
+    Serial.println(buf);
+}
+
+static void usage(const char * name) {
+    fprintf(stderr, "usage: %s [-p httpPort] [-s streamPort] [-f framesDir] [-r fps] [-c ov2640|ov3660|ov5640] [-d]\n", name);
+    exit(1);
+}
+
+int main(int argc, char ** argv) {
+    const char * frames = NULL;
+    float fps = 25;
+    uint16_t pid = OV2640_PID;
+    int opt;
+    while ((opt = getopt(argc, argv, "p:s:f:r:c:d")) != -1) {
+        switch (opt) {
+            case 'p': httpPort = atoi(optarg); break;
+            case 's': streamPort = atoi(optarg); break;
+            case 'f': frames = optarg; break;
+            case 'r': fps = atof(optarg); break;
+            case 'c':
+                if (!strcmp(optarg, "ov2640")) pid = OV2640_PID;
+                else if (!strcmp(optarg, "ov3660")) pid = OV3660_PID;
+                else if (!strcmp(optarg, "ov5640")) pid = OV5640_PID;
+                else usage(argv[0]);
+                break;
+            case 'd': debugData = true; break;
+            default: usage(argv[0]);
+        }
+    }
+    if (fps <= 0) usage(argv[0]);
+
+    // Keep the serial log in order when it is piped
+    setvbuf(stdout, NULL, _IOLBF, 0);
+
+    // Stream clients that vanish must not kill the process
+    signal(SIGPIPE, SIG_IGN);
+
+    Serial.printf("\r\n====\r\n%s\r\nCode Built: %s (base: %s)\r\n", myName, myVer, baseVersion);
+    if (!hostCameraInit(frames, fps, pid)) return 1;
+    sensorPID = esp_camera_sensor_get()->id.PID;
+
+    // There is no LED or lamp, but both are driven as on a board
+    ledInit(0, HIGH, LOW);
+    lampInit(4, 7);
+
+    settingsInit();
+    filesystemStart();
+    loadPrefs(SPIFFS);
+
+    sprintf(httpURL, "http://127.0.0.1:%d/", httpPort);
+    sprintf(streamURL, "http://127.0.0.1:%d/", streamPort);
+    startCameraServer(httpPort, streamPort);
+    Serial.printf("\r\nUse '%s' to connect\r\nStream viewer available at '%sview'\r\nRaw stream URL is '%s'\r\n",
+        httpURL, streamURL, streamURL);
+
+    while (true) pause();
+}
@@ -0,0 +1,123 @@
+//
+// Host build: Arduino core functions, timers and chip information.
+//
+
+#include <malloc.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include <Arduino.h>
+#include <esp_task_wdt.h>
+
+HardwareSerial Serial;
+EspClass ESP;
+
+// Pretend sizes for the figures the status pages show
+#define HOST_HEAP_SIZE      (320 * 1024)
+#define HOST_PSRAM_SIZE     (4 * 1024 * 1024)
+
+int64_t esp_timer_get_time() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+void delay(uint32_t ms) {
+    vTaskDelay(ms);
+}
+
+void delayMicroseconds(uint32_t us) {
+    struct timespec ts = { (time_t)(us / 1000000), (long)(us % 1000000) * 1000 };
+    nanosleep(&ts, NULL);
+}
+
+unsigned long millis() {
+    return (unsigned long)(esp_timer_get_time() / 1000);
+}
+
+unsigned long micros() {
+    return (unsigned long)esp_timer_get_time();
+}
+
+void pinMode(uint8_t pin, uint8_t mode) {}
+void digitalWrite(uint8_t pin, uint8_t val) {}
+int digitalRead(uint8_t pin) { return LOW; }
+
+double ledcSetup(uint8_t channel, double freq, uint8_t resolution_bits) { return freq; }
+void ledcAttachPin(uint8_t pin, uint8_t channel) {}
+void ledcWrite(uint8_t channel, uint32_t duty) {}
+
+esp_err_t ledc_fade_func_install(int intr_alloc_flags) { return ESP_OK; }
+esp_err_t ledc_set_duty_and_update(ledc_mode_t speed_mode, ledc_channel_t channel, uint32_t duty, uint32_t hpoint) {
+    return ESP_OK;
+}
+esp_err_t ledc_set_fade_time_and_start(ledc_mode_t speed_mode, ledc_channel_t channel, uint32_t target_duty,
+                                       uint32_t max_fade_time_ms, ledc_fade_mode_t fade_mode) {
+    return ESP_OK;
+}
+
+bool psramFound() { return true; }
+void * ps_malloc(size_t size) { return malloc(size); }
+void * ps_calloc(size_t n, size_t size) { return calloc(n, size); }
+void * ps_realloc(void * ptr, size_t size) { return realloc(ptr, size); }
+
+bool getLocalTime(struct tm * info, uint32_t ms) {
+    time_t now = time(NULL);
+    localtime_r(&now, info);
+    return true;
+}
+
+void configTime(long gmtOffset_sec, int daylightOffset_sec, const char * server1,
+                const char * server2, const char * server3) {}
+
+void periph_module_disable(periph_module_t periph) {}
+void periph_module_reset(periph_module_t periph) {}
+
+extern "C" uint8_t temprature_sens_read() {
+    return 120;     // fahrenheit
+}
+
+esp_err_t esp_task_wdt_init(uint32_t timeout, bool panic) { return ESP_OK; }
+esp_err_t esp_task_wdt_add(void * task) { return ESP_OK; }
+
+const char * esp_err_to_name(esp_err_t code) {
+    switch (code) {
+        case ESP_OK: return "ESP_OK";
+        case ESP_FAIL: return "ESP_FAIL";
+        case ESP_ERR_NO_MEM: return "ESP_ERR_NO_MEM";
+        case ESP_ERR_INVALID_ARG: return "ESP_ERR_INVALID_ARG";
+        case ESP_ERR_INVALID_STATE: return "ESP_ERR_INVALID_STATE";
+        case ESP_ERR_NOT_FOUND: return "ESP_ERR_NOT_FOUND";
+        case ESP_ERR_TIMEOUT: return "ESP_ERR_TIMEOUT";
+        case ESP_ERR_HTTPD_RESP_SEND: return "ESP_ERR_HTTPD_RESP_SEND";
+        case ESP_ERR_HTTPD_INVALID_REQ: return "ESP_ERR_HTTPD_INVALID_REQ";
+        case ESP_ERR_HTTPD_RESULT_TRUNC: return "ESP_ERR_HTTPD_RESULT_TRUNC";
+        default: return "UNKNOWN ERROR";
+    }
+}
+
+static uint32_t heap_used() {
+    struct mallinfo2 info = mallinfo2();
+    return (uint32_t)info.uordblks;
+}
+
+static uint32_t heap_free(uint32_t size) {
+    uint32_t used = heap_used();
+    return (used < size) ? size - used : 0;
+}
+
+const char * EspClass::getSdkVersion() { return "host"; }
+const char * EspClass::getChipModel() { return "host"; }
+uint32_t EspClass::getCpuFreqMHz() { return 240; }
+uint32_t EspClass::getHeapSize() { return HOST_HEAP_SIZE; }
+uint32_t EspClass::getFreeHeap() { return heap_free(HOST_HEAP_SIZE); }
+uint32_t EspClass::getMinFreeHeap() { return heap_free(HOST_HEAP_SIZE); }
+uint32_t EspClass::getMaxAllocHeap() { return heap_free(HOST_HEAP_SIZE); }
+uint32_t EspClass::getPsramSize() { return HOST_PSRAM_SIZE; }
+uint32_t EspClass::getFreePsram() { return heap_free(HOST_PSRAM_SIZE); }
+uint32_t EspClass::getMinFreePsram() { return heap_free(HOST_PSRAM_SIZE); }
+uint32_t EspClass::getMaxAllocPsram() { return heap_free(HOST_PSRAM_SIZE); }
+uint32_t EspClass::getSketchSize() { return 1024 * 1024; }
+uint32_t EspClass::getFreeSketchSpace() { return 3 * 1024 * 1024; }
+String EspClass::getSketchMD5() { return String("00000000000000000000000000000000"); }
+void EspClass::restart() { exit(0); }
@@ -0,0 +1,312 @@
+//
+// Host build: simulated camera sensor.
+//
+// Frames are delivered at a fixed sensor rate: esp_camera_fb_get() blocks
+// until the next frame boundary, as the real driver does once its buffers
+// are drained. With a frame directory the files are served in name order,
+// round and round. Without one, frames are synthesised: a valid 8x8 grey
+// JPEG padded with comment segments to roughly the size the OV2640 would
+// produce for the current framesize and quality, so bitrate and adaptive
+// quality behave sensibly.
+//
+
+#include <dirent.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+#include <algorithm>
+#include <map>
+#include <string>
+#include <vector>
+
+#include <Arduino.h>
+#include <esp_camera.h>
+
+#include "host.h"
+
+const resolution_info_t resolution[FRAMESIZE_INVALID] = {
+    {   96,   96 }, {  160,  120 }, {  176,  144 }, {  240,  176 }, {  240,  240 }, {  320,  240 },
+    {  400,  296 }, {  480,  320 }, {  640,  480 }, {  800,  600 }, { 1024,  768 }, { 1280,  720 },
+    { 1280, 1024 }, { 1600, 1200 }, { 1920, 1080 }, {  720, 1280 }, {  864, 1536 }, { 2048, 1536 },
+    { 2560, 1440 }, { 2560, 1600 }, { 1080, 1920 }, { 2560, 1920 },
+};
+
+// Baseline JPEG of a flat grey 8x8 image, with one-symbol Huffman tables
+static const uint8_t greyHead[] = {
+    0xFF, 0xD8,
+    0xFF, 0xDB, 0x00, 0x43, 0x00,
+    1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+    1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+    0xFF, 0xC0, 0x00, 0x0B, 0x08, 0x00, 0x08, 0x00, 0x08, 0x01, 0x01, 0x11, 0x00,
+    0xFF, 0xC4, 0x00, 0x26,
+    0x00, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0x00,
+    0x10, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0x00,
+};
+static const uint8_t greyScan[] = {
+    0xFF, 0xDA, 0x00, 0x08, 0x01, 0x01, 0x00, 0x00, 0x3F, 0x00,
+    0x3F,
+    0xFF, 0xD9,
+};
+
+typedef struct {
+    std::vector<uint8_t> data;
+    uint16_t width;
+    uint16_t height;
+} host_frame_t;
+
+static sensor_t sensor;
+static std::map<int, int> registers;
+static std::vector<host_frame_t> files;
+static size_t nextFile = 0;
+static host_frame_t synthetic;
+static int syntheticFramesize = -1;
+static int syntheticQuality = -1;
+static int64_t framePeriod = 40000;
+static int64_t nextFrame = 0;
+static uint32_t frameCount = 0;
+static SemaphoreHandle_t cameraMutex = NULL;
+
+// Simulated auto exposure: each frame closes half the gap to what the lamp level calls for
+static int lampLevel = 0;
+static int exposure = 800;
+static int gain = 16;
+
+static void run_aec() {
+    if (sensor.status.aec) exposure += (800 - lampLevel * 6 - exposure) / 2;
+    if (sensor.status.agc) gain += (16 - lampLevel / 8 - gain) / 2;
+    if (sensor.id.PID == OV2640_PID) {
+        registers[0x145] = (exposure >> 10) & 0x3f;
+        registers[0x110] = (exposure >> 2) & 0xff;
+        registers[0x104] = exposure & 0x03;
+        registers[0x100] = gain;
+    } else {
+        registers[0x3500] = exposure;
+        registers[0x350a] = gain;
+    }
+}
+
+// Roughly what an OV2640 produces: about 0.1 bytes per pixel at quality 10
+static void synthesise(int framesize, int quality) {
+    const resolution_info_t & res = resolution[framesize];
+    size_t target = (size_t)((double)res.width * res.height * 1.2 / (quality + 2));
+    std::vector<uint8_t> & out = synthetic.data;
+    out.assign(greyHead, greyHead + 2);
+    size_t fixed = sizeof(greyHead) + sizeof(greyScan);
+    size_t padding = (target > fixed) ? target - fixed : 0;
+    while (padding > 4) {
+        size_t len = std::min(padding - 4, (size_t)65533);
+        out.push_back(0xFF);
+        out.push_back(0xFE);
+        out.push_back((len + 2) >> 8);
+        out.push_back((len + 2) & 0xFF);
+        out.insert(out.end(), len, 'x');
+        padding -= len + 4;
+    }
+    out.insert(out.end(), greyHead + 2, greyHead + sizeof(greyHead));
+    out.insert(out.end(), greyScan, greyScan + sizeof(greyScan));
+    synthetic.width = res.width;
+    synthetic.height = res.height;
+    syntheticFramesize = framesize;
+    syntheticQuality = quality;
+}
+
+static bool load_files(const char * dir) {
+    DIR * d = opendir(dir);
+    if (!d) {
+        Serial.printf("CAMERA: cannot open frame directory %s\r\n", dir);
+        return false;
+    }
+    std::vector<std::string> names;
+    struct dirent * entry;
+    while ((entry = readdir(d)) != NULL) {
+        const char * ext = strrchr(entry->d_name, '.');
+        if (ext && (!strcasecmp(ext, ".jpg") || !strcasecmp(ext, ".jpeg"))) names.push_back(entry->d_name);
+    }
+    closedir(d);
+    std::sort(names.begin(), names.end());
+    for (size_t i = 0; i < names.size(); i++) {
+        std::string path = std::string(dir) + "/" + names[i];
+        FILE * f = fopen(path.c_str(), "rb");
+        if (!f) continue;
+        host_frame_t frame;
+        uint8_t buf[65536];
+        size_t n;
+        while ((n = fread(buf, 1, sizeof(buf), f)) > 0) frame.data.insert(frame.data.end(), buf, buf + n);
+        fclose(f);
+        // Take the dimensions from the SOF0 marker if there is one
+        frame.width = frame.height = 0;
+        for (size_t p = 2; p + 8 < frame.data.size(); p++) {
+            if (frame.data[p] == 0xFF && (frame.data[p + 1] == 0xC0 || frame.data[p + 1] == 0xC2)) {
+                frame.height = (frame.data[p + 5] << 8) | frame.data[p + 6];
+                frame.width = (frame.data[p + 7] << 8) | frame.data[p + 8];
+                break;
+            }
+        }
+        files.push_back(frame);
+    }
+    Serial.printf("CAMERA: loaded %u frames from %s\r\n", (uint32_t)files.size(), dir);
+    return !files.empty();
+}
+
+static int set_framesize(sensor_t * s, framesize_t framesize) {
+    if (framesize >= FRAMESIZE_INVALID) return -1;
+    s->status.framesize = framesize;
+    return 0;
+}
+
+static int set_quality(sensor_t * s, int quality) {
+    s->status.quality = constrain(quality, 0, 63);
+    return 0;
+}
+
+static int get_reg(sensor_t * s, int reg, int mask) {
+    std::map<int, int>::const_iterator it = registers.find(reg);
+    return ((it == registers.end()) ? 0 : it->second) & mask;
+}
+
+static int set_reg(sensor_t * s, int reg, int mask, int value) {
+    registers[reg] = (get_reg(s, reg, ~mask) & ~mask) | (value & mask);
+    return 0;
+}
+
+static int set_xclk(sensor_t * s, int timer, int xclk) {
+    s->xclk_freq_hz = xclk * 1000000;
+    return 0;
+}
+
+// Settings with no effect on the simulated frames just record their value
+#define SETTER(name, field) \
+    static int name(sensor_t * s, int value) { s->status.field = value; return 0; }
+SETTER(set_contrast, contrast)
+SETTER(set_brightness, brightness)
+SETTER(set_saturation, saturation)
+SETTER(set_sharpness, sharpness)
+SETTER(set_denoise, denoise)
+SETTER(set_colorbar, colorbar)
+SETTER(set_whitebal, awb)
+SETTER(set_gain_ctrl, agc)
+SETTER(set_exposure_ctrl, aec)
+SETTER(set_hmirror, hmirror)
+SETTER(set_vflip, vflip)
+SETTER(set_aec2, aec2)
+SETTER(set_awb_gain, awb_gain)
+SETTER(set_agc_gain, agc_gain)
+SETTER(set_aec_value, aec_value)
+SETTER(set_special_effect, special_effect)
+SETTER(set_wb_mode, wb_mode)
+SETTER(set_ae_level, ae_level)
+SETTER(set_dcw, dcw)
+SETTER(set_bpc, bpc)
+SETTER(set_wpc, wpc)
+SETTER(set_raw_gma, raw_gma)
+SETTER(set_lenc, lenc)
+
+static int set_gainceiling(sensor_t * s, gainceiling_t gainceiling) {
+    s->status.gainceiling = gainceiling;
+    return 0;
+}
+
+bool hostCameraInit(const char * dir, float fps, uint16_t pid) {
+    if (dir && !load_files(dir)) return false;
+    framePeriod = (int64_t)(1000000 / fps);
+    cameraMutex = xSemaphoreCreateMutex();
+
+    sensor.id.PID = pid;
+    sensor.pixformat = PIXFORMAT_JPEG;
+    sensor.xclk_freq_hz = 8000000;
+    sensor.status.framesize = FRAMESIZE_SVGA;
+    sensor.status.quality = 12;
+    sensor.status.awb = 1;
+    sensor.status.awb_gain = 1;
+    sensor.status.aec = 1;
+    sensor.status.agc = 1;
+    sensor.status.aec_value = 204;
+    sensor.status.wpc = 1;
+    sensor.status.raw_gma = 1;
+    sensor.status.lenc = 1;
+    sensor.status.dcw = 1;
+
+    sensor.set_framesize = set_framesize;
+    sensor.set_quality = set_quality;
+    sensor.set_contrast = set_contrast;
+    sensor.set_brightness = set_brightness;
+    sensor.set_saturation = set_saturation;
+    sensor.set_sharpness = set_sharpness;
+    sensor.set_denoise = set_denoise;
+    sensor.set_gainceiling = set_gainceiling;
+    sensor.set_colorbar = set_colorbar;
+    sensor.set_whitebal = set_whitebal;
+    sensor.set_gain_ctrl = set_gain_ctrl;
+    sensor.set_exposure_ctrl = set_exposure_ctrl;
+    sensor.set_hmirror = set_hmirror;
+    sensor.set_vflip = set_vflip;
+    sensor.set_aec2 = set_aec2;
+    sensor.set_awb_gain = set_awb_gain;
+    sensor.set_agc_gain = set_agc_gain;
+    sensor.set_aec_value = set_aec_value;
+    sensor.set_special_effect = set_special_effect;
+    sensor.set_wb_mode = set_wb_mode;
+    sensor.set_ae_level = set_ae_level;
+    sensor.set_dcw = set_dcw;
+    sensor.set_bpc = set_bpc;
+    sensor.set_wpc = set_wpc;
+    sensor.set_raw_gma = set_raw_gma;
+    sensor.set_lenc = set_lenc;
+    sensor.get_reg = get_reg;
+    sensor.set_reg = set_reg;
+    sensor.set_xclk = set_xclk;
+    return true;
+}
+
+void hostCameraLamp(int percent) {
+    xSemaphoreTake(cameraMutex, portMAX_DELAY);
+    lampLevel = max(percent, 0);
+    xSemaphoreGive(cameraMutex);
+}
+
+camera_fb_t * esp_camera_fb_get() {
+    // Wait for the next frame boundary
+    xSemaphoreTake(cameraMutex, portMAX_DELAY);
+    int64_t now = esp_timer_get_time();
+    if (nextFrame < now - framePeriod) nextFrame = now;
+    int64_t wait = nextFrame - now;
+    nextFrame += framePeriod;
+    const host_frame_t * frame;
+    if (!files.empty()) {
+        frame = &files[nextFile];
+        nextFile = (nextFile + 1) % files.size();
+    } else {
+        if ((syntheticFramesize != sensor.status.framesize) || (syntheticQuality != sensor.status.quality)) {
+            synthesise(sensor.status.framesize, sensor.status.quality);
+        }
+        frame = &synthetic;
+    }
+    camera_fb_t * fb = (camera_fb_t *)calloc(1, sizeof(camera_fb_t));
+    fb->len = frame->data.size();
+    fb->buf = (uint8_t *)malloc(fb->len);
+    memcpy(fb->buf, frame->data.data(), fb->len);
+    fb->width = frame->width;
+    fb->height = frame->height;
+    fb->format = PIXFORMAT_JPEG;
+    frameCount++;
+    run_aec();
+    xSemaphoreGive(cameraMutex);
+
+    if (wait > 0) delayMicroseconds(wait);
+    // Like the driver, stamp frames with esp_timer time rather than the wall clock
+    int64_t us = esp_timer_get_time();
+    fb->timestamp.tv_sec = us / 1000000;
+    fb->timestamp.tv_usec = us % 1000000;
+    return fb;
+}
+
+void esp_camera_fb_return(camera_fb_t * fb) {
+    if (!fb) return;
+    free(fb->buf);
+    free(fb);
+}
+
+sensor_t * esp_camera_sensor_get() {
+    return cameraMutex ? &sensor : NULL;
+}
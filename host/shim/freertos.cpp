@@ -0,0 +1,274 @@
+//
+// Host build: FreeRTOS tasks, notifications, semaphores and queues on
+// POSIX threads.
+//
+// Task handles are never freed, because another task may still hold one and
+// notify it after the task has gone; a task is a few dozen bytes.
+//
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <errno.h>
+#include <pthread.h>
+#include <deque>
+#include <vector>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "freertos/queue.h"
+
+struct host_task {
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    uint32_t notify;
+    bool pending;               // a notification has arrived since the last wait
+    TaskFunction_t fn;
+    void * arg;
+    char name[16];
+};
+
+struct host_semaphore {
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    UBaseType_t count;
+    UBaseType_t max;
+};
+
+struct host_queue {
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    std::deque<std::vector<uint8_t> > items;
+    UBaseType_t length;
+    UBaseType_t itemSize;
+};
+
+static __thread host_task * currentTask = NULL;
+
+// Condition variables time out against the monotonic clock, like the tick count
+static pthread_condattr_t make_monotonic() {
+    pthread_condattr_t attr;
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    return attr;
+}
+
+static pthread_condattr_t * monotonic() {
+    static pthread_condattr_t attr = make_monotonic();
+    return &attr;
+}
+
+static host_task * task_new(const char * name) {
+    host_task * task = new host_task();
+    pthread_mutex_init(&task->lock, NULL);
+    pthread_cond_init(&task->cond, monotonic());
+    strncpy(task->name, name ? name : "", sizeof(task->name) - 1);
+    return task;
+}
+
+// Absolute CLOCK_MONOTONIC deadline 'ticks' milliseconds from now
+static struct timespec deadline(TickType_t ticks) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    ts.tv_sec += ticks / 1000;
+    ts.tv_nsec += (long)(ticks % 1000) * 1000000;
+    if (ts.tv_nsec >= 1000000000) {
+        ts.tv_sec++;
+        ts.tv_nsec -= 1000000000;
+    }
+    return ts;
+}
+
+// Wait on 'cond' until 'ready' returns true or 'ticks' pass; 'lock' is held throughout
+template<typename F> static bool wait_for(pthread_cond_t * cond, pthread_mutex_t * lock, TickType_t ticks, F ready) {
+    struct timespec until = deadline(ticks);
+    while (!ready()) {
+        if (ticks == 0) return false;
+        if (ticks == portMAX_DELAY) {
+            pthread_cond_wait(cond, lock);
+        } else if (pthread_cond_timedwait(cond, lock, &until) == ETIMEDOUT) {
+            return ready();
+        }
+    }
+    return true;
+}
+
+static void * task_main(void * arg) {
+    currentTask = (host_task *)arg;
+    currentTask->fn(currentTask->arg);
+    return NULL;
+}
+
+BaseType_t xTaskCreate(TaskFunction_t fn, const char * name, uint32_t stack, void * arg,
+                       UBaseType_t priority, TaskHandle_t * handle) {
+    host_task * task = task_new(name);
+    task->fn = fn;
+    task->arg = arg;
+    // Handed back before the task runs, as callers may rely on it being set
+    if (handle) *handle = task;
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+    pthread_t thread;
+    int res = pthread_create(&thread, &attr, task_main, task);
+    pthread_attr_destroy(&attr);
+    if (res != 0) {
+        if (handle) *handle = NULL;
+        return pdFAIL;
+    }
+    return pdPASS;
+}
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t fn, const char * name, uint32_t stack, void * arg,
+                                   UBaseType_t priority, TaskHandle_t * handle, BaseType_t core) {
+    return xTaskCreate(fn, name, stack, arg, priority, handle);
+}
+
+void vTaskDelete(TaskHandle_t task) {
+    // Only self deletion is used by the sketch
+    if (task == NULL || task == currentTask) pthread_exit(NULL);
+}
+
+void vTaskDelay(TickType_t ticks) {
+    struct timespec ts = { (time_t)(ticks / 1000), (long)(ticks % 1000) * 1000000 };
+    while (nanosleep(&ts, &ts) == -1 && errno == EINTR) {}
+}
+
+TickType_t xTaskGetTickCount() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (TickType_t)(ts.tv_sec * 1000 + ts.tv_nsec / 1000000);
+}
+
+TaskHandle_t xTaskGetCurrentTaskHandle() {
+    if (!currentTask) currentTask = task_new("thread");
+    return currentTask;
+}
+
+const char * pcTaskGetName(TaskHandle_t task) {
+    if (!task) task = xTaskGetCurrentTaskHandle();
+    return task->name;
+}
+
+BaseType_t xTaskNotify(TaskHandle_t task, uint32_t value, eNotifyAction action) {
+    BaseType_t res = pdPASS;
+    pthread_mutex_lock(&task->lock);
+    switch (action) {
+        case eSetBits: task->notify |= value; break;
+        case eIncrement: task->notify++; break;
+        case eSetValueWithOverwrite: task->notify = value; break;
+        case eSetValueWithoutOverwrite:
+            if (task->pending) res = pdFAIL;
+            else task->notify = value;
+            break;
+        default: break;
+    }
+    if (res == pdPASS) task->pending = true;
+    pthread_cond_broadcast(&task->cond);
+    pthread_mutex_unlock(&task->lock);
+    return res;
+}
+
+BaseType_t xTaskNotifyWait(uint32_t clearOnEntry, uint32_t clearOnExit, uint32_t * value, TickType_t wait) {
+    host_task * task = xTaskGetCurrentTaskHandle();
+    pthread_mutex_lock(&task->lock);
+    if (!task->pending) task->notify &= ~clearOnEntry;
+    bool got = wait_for(&task->cond, &task->lock, wait, [task]() { return task->pending; });
+    if (value) *value = task->notify;
+    if (got) {
+        task->notify &= ~clearOnExit;
+        task->pending = false;
+    }
+    pthread_mutex_unlock(&task->lock);
+    return got ? pdTRUE : pdFALSE;
+}
+
+uint32_t ulTaskNotifyTake(BaseType_t clear, TickType_t wait) {
+    host_task * task = xTaskGetCurrentTaskHandle();
+    pthread_mutex_lock(&task->lock);
+    wait_for(&task->cond, &task->lock, wait, [task]() { return task->notify != 0; });
+    uint32_t value = task->notify;
+    if (value) task->notify = clear ? 0 : value - 1;
+    task->pending = (task->notify != 0);
+    pthread_mutex_unlock(&task->lock);
+    return value;
+}
+
+SemaphoreHandle_t xSemaphoreCreateCounting(UBaseType_t max, UBaseType_t initial) {
+    host_semaphore * sem = new host_semaphore();
+    pthread_mutex_init(&sem->lock, NULL);
+    pthread_cond_init(&sem->cond, monotonic());
+    sem->count = initial;
+    sem->max = max;
+    return sem;
+}
+
+BaseType_t xSemaphoreTake(SemaphoreHandle_t sem, TickType_t wait) {
+    pthread_mutex_lock(&sem->lock);
+    bool got = wait_for(&sem->cond, &sem->lock, wait, [sem]() { return sem->count > 0; });
+    if (got) sem->count--;
+    pthread_mutex_unlock(&sem->lock);
+    return got ? pdTRUE : pdFALSE;
+}
+
+BaseType_t xSemaphoreGive(SemaphoreHandle_t sem) {
+    pthread_mutex_lock(&sem->lock);
+    bool given = (sem->count < sem->max);
+    if (given) sem->count++;
+    pthread_cond_signal(&sem->cond);
+    pthread_mutex_unlock(&sem->lock);
+    return given ? pdTRUE : pdFALSE;
+}
+
+void vSemaphoreDelete(SemaphoreHandle_t sem) {
+    pthread_cond_destroy(&sem->cond);
+    pthread_mutex_destroy(&sem->lock);
+    delete sem;
+}
+
+QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t itemSize) {
+    host_queue * queue = new host_queue();
+    pthread_mutex_init(&queue->lock, NULL);
+    pthread_cond_init(&queue->cond, monotonic());
+    queue->length = length;
+    queue->itemSize = itemSize;
+    return queue;
+}
+
+BaseType_t xQueueSend(QueueHandle_t queue, const void * item, TickType_t wait) {
+    pthread_mutex_lock(&queue->lock);
+    bool room = wait_for(&queue->cond, &queue->lock, wait, [queue]() { return queue->items.size() < queue->length; });
+    if (room) {
+        const uint8_t * bytes = (const uint8_t *)item;
+        queue->items.push_back(std::vector<uint8_t>(bytes, bytes + queue->itemSize));
+        pthread_cond_broadcast(&queue->cond);
+    }
+    pthread_mutex_unlock(&queue->lock);
+    return room ? pdPASS : errQUEUE_FULL;
+}
+
+BaseType_t xQueueReceive(QueueHandle_t queue, void * item, TickType_t wait) {
+    pthread_mutex_lock(&queue->lock);
+    bool got = wait_for(&queue->cond, &queue->lock, wait, [queue]() { return !queue->items.empty(); });
+    if (got) {
+        memcpy(item, queue->items.front().data(), queue->itemSize);
+        queue->items.pop_front();
+        pthread_cond_broadcast(&queue->cond);
+    }
+    pthread_mutex_unlock(&queue->lock);
+    return got ? pdPASS : errQUEUE_EMPTY;
+}
+
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t queue) {
+    pthread_mutex_lock(&queue->lock);
+    UBaseType_t n = queue->items.size();
+    pthread_mutex_unlock(&queue->lock);
+    return n;
+}
+
+void vQueueDelete(QueueHandle_t queue) {
+    pthread_cond_destroy(&queue->cond);
+    pthread_mutex_destroy(&queue->lock);
+    delete queue;
+}
@@ -0,0 +1,120 @@
+//
+// Host build: in-memory SPIFFS and Preferences, and the WiFi object.
+//
+
+#include <Arduino.h>
+#include <FS.h>
+#include <SPIFFS.h>
+#include <Preferences.h>
+#include <WiFi.h>
+
+SPIFFSFS SPIFFS;
+WiFiClass WiFi;
+
+namespace fs {
+
+File::File(FileMap * files, const std::string & path, bool dir, bool writing)
+    : files(files), path(path), dir(dir), pos(0), writing(writing) {}
+
+size_t File::size() const {
+    if (!files || dir) return 0;
+    if (writing) return data.size();
+    FileMap::const_iterator it = files->find(path);
+    return (it == files->end()) ? 0 : it->second.size();
+}
+
+int File::available() {
+    if (!files || dir || writing) return 0;
+    return size() - pos;
+}
+
+int File::read() {
+    if (available() <= 0) return -1;
+    return (uint8_t)(*files)[path][pos++];
+}
+
+size_t File::write(const uint8_t * buf, size_t size) {
+    if (!files || !writing) return 0;
+    data.append((const char *)buf, size);
+    return size;
+}
+
+// Directories are flat; every file is an entry of "/"
+File File::openNextFile() {
+    if (!files || !dir) return File();
+    FileMap::iterator it = files->begin();
+    for (size_t i = 0; (i < pos) && (it != files->end()); i++) it++;
+    if (it == files->end()) return File();
+    pos++;
+    return File(files, it->first, false, false);
+}
+
+void File::close() {
+    if (files && writing) (*files)[path] = data;
+    files = NULL;
+}
+
+File FS::open(const char * path, const char * mode) {
+    std::string name(path);
+    if (name == "/") return File(&files, name, true, false);
+    if (mode[0] == 'r') {
+        return files.count(name) ? File(&files, name, false, false) : File();
+    }
+    File file(&files, name, false, true);
+    if (mode[0] == 'a' && files.count(name)) file.print(files[name].c_str());
+    return file;
+}
+
+bool FS::exists(const char * path) {
+    return files.count(path) != 0;
+}
+
+bool FS::remove(const char * path) {
+    return files.erase(path) != 0;
+}
+
+}
+
+size_t SPIFFSFS::usedBytes() {
+    size_t used = 0;
+    for (fs::FileMap::const_iterator it = files.begin(); it != files.end(); it++) used += it->second.size();
+    return used;
+}
+
+// Every namespace lives in one map, keyed "namespace/key"
+static std::map<std::string, std::string> nvs;
+
+bool Preferences::begin(const char * name, bool readOnly) {
+    space = name;
+    return true;
+}
+
+void Preferences::end() {
+    space.clear();
+}
+
+bool Preferences::remove(const char * key) {
+    return nvs.erase(space + "/" + key) != 0;
+}
+
+size_t Preferences::putString(const char * key, const char * value) {
+    nvs[space + "/" + key] = value;
+    return strlen(value);
+}
+
+size_t Preferences::getString(const char * key, char * value, size_t maxLen) {
+    std::map<std::string, std::string>::const_iterator it = nvs.find(space + "/" + key);
+    if (it == nvs.end() || maxLen == 0) {
+        if (maxLen) value[0] = 0;
+        return 0;
+    }
+    size_t len = std::min(it->second.size(), maxLen - 1);
+    memcpy(value, it->second.data(), len);
+    value[len] = 0;
+    return len;
+}
+
+String Preferences::getString(const char * key, const String & defaultValue) {
+    std::map<std::string, std::string>::const_iterator it = nvs.find(space + "/" + key);
+    return (it == nvs.end()) ? defaultValue : String(it->second);
+}
@@ -0,0 +1,13 @@
+//
+// Host build: controls for the simulated hardware.
+//
+
+#pragma once
+
+#include <stdint.h>
+
+// Serve JPEG files from 'dir' (NULL = synthesise frames) at 'fps' frames per second
+extern bool hostCameraInit(const char * dir, float fps, uint16_t pid);
+
+// The lamp is at 'percent'; the simulated auto exposure starts to adjust to it
+extern void hostCameraLamp(int percent);
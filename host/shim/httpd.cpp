@@ -0,0 +1,713 @@
+//
+// Host build: esp_http_server over POSIX sockets.
+//
+// Like the real server, each instance is one thread that selects over its
+// listening socket and open sessions and runs handlers one at a time, so a
+// slow handler stalls every other request on that port. Sessions are kept
+// alive between requests and closed when a handler fails. Session contexts
+// and their free functions behave as in ESP-IDF 4.4: the free function runs
+// when the session closes, whether the peer went away or
+// httpd_sess_trigger_close() was called from another task.
+//
+// WebSocket URIs work as with CONFIG_HTTPD_WS_SUPPORT: httpd does the
+// handshake, calls the handler once with HTTP_GET, then once per data
+// message; pings and closes are answered by the server itself unless the
+// URI sets handle_ws_control_frames, when they go to the handler too.
+//
+// Not emulated: LRU purging, request/response header size limits,
+// fragmented WebSocket messages, and the control socket (work and close
+// requests go through a pipe instead).
+//
+
+#include <errno.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <Arduino.h>
+#include <esp_http_server.h>
+
+typedef struct {
+    int fd;
+    std::string input;          // bytes received but not yet consumed
+    void * ctx;
+    httpd_free_ctx_fn_t free_ctx;
+    const httpd_uri_t * ws;     // the WebSocket URI once the handshake is done
+} session_t;
+
+typedef struct {
+    httpd_config_t config;
+    std::vector<httpd_uri_t> uris;
+    std::vector<session_t *> sessions;
+    int listenFd;
+    int wakeFds[2];
+    pthread_t thread;
+} server_t;
+
+// Messages to the server thread
+typedef struct {
+    httpd_work_fn_t work;       // NULL to close 'fd'
+    void * arg;
+    int fd;
+} server_msg_t;
+
+// What httpd_req_t::aux points to
+typedef struct {
+    session_t * session;
+    std::string path;
+    std::string query;
+    std::vector<std::pair<std::string, std::string> > headers;
+    size_t remaining;           // body bytes not yet read
+    const char * status;
+    const char * type;
+    std::vector<std::pair<const char *, const char *> > respHeaders;
+    bool headersSent;
+    bool failed;
+    httpd_ws_type_t wsType;     // the WebSocket message being handled
+    std::string wsPayload;
+} request_t;
+
+// SHA-1, for the WebSocket handshake only
+static void sha1(const std::string & data, uint8_t out[20]) {
+    uint32_t h[5] = { 0x67452301, 0xEFCDAB89, 0x98BADCFE, 0x10325476, 0xC3D2E1F0 };
+    std::string msg = data;
+    uint64_t bits = (uint64_t)data.size() * 8;
+    msg += (char)0x80;
+    while (msg.size() % 64 != 56) msg += (char)0;
+    for (int i = 7; i >= 0; i--) msg += (char)(bits >> (i * 8));
+    for (size_t chunk = 0; chunk < msg.size(); chunk += 64) {
+        uint32_t w[80];
+        for (int i = 0; i < 16; i++) {
+            const uint8_t * b = (const uint8_t *)msg.data() + chunk + i * 4;
+            w[i] = (b[0] << 24) | (b[1] << 16) | (b[2] << 8) | b[3];
+        }
+        for (int i = 16; i < 80; i++) {
+            uint32_t v = w[i - 3] ^ w[i - 8] ^ w[i - 14] ^ w[i - 16];
+            w[i] = (v << 1) | (v >> 31);
+        }
+        uint32_t a = h[0], b = h[1], c = h[2], d = h[3], e = h[4];
+        for (int i = 0; i < 80; i++) {
+            uint32_t f, k;
+            if (i < 20)      { f = (b & c) | (~b & d);          k = 0x5A827999; }
+            else if (i < 40) { f = b ^ c ^ d;                   k = 0x6ED9EBA1; }
+            else if (i < 60) { f = (b & c) | (b & d) | (c & d); k = 0x8F1BBCDC; }
+            else             { f = b ^ c ^ d;                   k = 0xCA62C1D6; }
+            uint32_t t = ((a << 5) | (a >> 27)) + f + e + k + w[i];
+            e = d;
+            d = c;
+            c = (b << 30) | (b >> 2);
+            b = a;
+            a = t;
+        }
+        h[0] += a; h[1] += b; h[2] += c; h[3] += d; h[4] += e;
+    }
+    for (int i = 0; i < 20; i++) out[i] = h[i / 4] >> (24 - (i % 4) * 8);
+}
+
+static std::string base64(const uint8_t * data, size_t len) {
+    static const char table[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    std::string out;
+    for (size_t i = 0; i < len; i += 3) {
+        uint32_t v = data[i] << 16;
+        if (i + 1 < len) v |= data[i + 1] << 8;
+        if (i + 2 < len) v |= data[i + 2];
+        out += table[(v >> 18) & 63];
+        out += table[(v >> 12) & 63];
+        out += (i + 1 < len) ? table[(v >> 6) & 63] : '=';
+        out += (i + 2 < len) ? table[v & 63] : '=';
+    }
+    return out;
+}
+
+static bool send_all(int fd, const char * buf, size_t len) {
+    while (len > 0) {
+        ssize_t n = send(fd, buf, len, MSG_NOSIGNAL);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        buf += n;
+        len -= n;
+    }
+    return true;
+}
+
+static void close_session(server_t * server, session_t * session) {
+    for (size_t i = 0; i < server->sessions.size(); i++) {
+        if (server->sessions[i] == session) {
+            server->sessions.erase(server->sessions.begin() + i);
+            break;
+        }
+    }
+    if (session->ctx) {
+        if (session->free_ctx) session->free_ctx(session->ctx);
+        else free(session->ctx);
+    }
+    close(session->fd);
+    delete session;
+}
+
+static session_t * find_session(server_t * server, int fd) {
+    for (size_t i = 0; i < server->sessions.size(); i++) {
+        if (server->sessions[i]->fd == fd) return server->sessions[i];
+    }
+    return NULL;
+}
+
+static void post(server_t * server, const server_msg_t & msg) {
+    ssize_t n;
+    do {
+        n = write(server->wakeFds[1], &msg, sizeof(msg));
+    } while ((n < 0) && (errno == EINTR));
+}
+
+static bool send_headers(httpd_req_t * r, const char * extra) {
+    request_t * req = (request_t *)r->aux;
+    std::string head = std::string("HTTP/1.1 ") + req->status + "\r\nContent-Type: " + req->type + "\r\n";
+    for (size_t i = 0; i < req->respHeaders.size(); i++) {
+        head += std::string(req->respHeaders[i].first) + ": " + req->respHeaders[i].second + "\r\n";
+    }
+    head += extra;
+    head += "\r\n";
+    req->headersSent = true;
+    return send_all(req->session->fd, head.data(), head.size());
+}
+
+static bool parse_request(server_t * server, session_t * session, httpd_req_t * r, request_t * req) {
+    size_t end = session->input.find("\r\n\r\n");
+    if (end == std::string::npos) return false;
+    std::string head = session->input.substr(0, end);
+    session->input.erase(0, end + 4);
+
+    size_t lineEnd = head.find("\r\n");
+    std::string line = head.substr(0, lineEnd);
+    size_t sp1 = line.find(' ');
+    size_t sp2 = line.find(' ', sp1 + 1);
+    std::string method = line.substr(0, sp1);
+    std::string uri = line.substr(sp1 + 1, sp2 - sp1 - 1);
+    if (method == "GET") r->method = HTTP_GET;
+    else if (method == "POST") r->method = HTTP_POST;
+    else if (method == "HEAD") r->method = HTTP_HEAD;
+    else if (method == "PUT") r->method = HTTP_PUT;
+    else if (method == "DELETE") r->method = HTTP_DELETE;
+    else if (method == "OPTIONS") r->method = HTTP_OPTIONS;
+    else r->method = -1;
+    strncpy((char *)r->uri, uri.c_str(), HTTPD_MAX_URI_LEN);
+
+    size_t q = uri.find('?');
+    req->path = uri.substr(0, q);
+    if (q != std::string::npos) req->query = uri.substr(q + 1);
+
+    while (lineEnd != std::string::npos) {
+        size_t start = lineEnd + 2;
+        lineEnd = head.find("\r\n", start);
+        std::string field = head.substr(start, (lineEnd == std::string::npos) ? std::string::npos : lineEnd - start);
+        size_t colon = field.find(':');
+        if (colon == std::string::npos) continue;
+        size_t value = field.find_first_not_of(' ', colon + 1);
+        req->headers.push_back(std::make_pair(field.substr(0, colon),
+            (value == std::string::npos) ? std::string() : field.substr(value)));
+    }
+    char len[16];
+    if (httpd_req_get_hdr_value_str(r, "Content-Length", len, sizeof(len)) == ESP_OK) {
+        r->content_len = strtoul(len, NULL, 10);
+    }
+    req->remaining = r->content_len;
+    return true;
+}
+
+static const httpd_uri_t * find_handler(server_t * server, httpd_req_t * r, bool * pathFound) {
+    request_t * req = (request_t *)r->aux;
+    *pathFound = false;
+    for (size_t i = 0; i < server->uris.size(); i++) {
+        const httpd_uri_t & uri = server->uris[i];
+        bool match = server->config.uri_match_fn
+            ? server->config.uri_match_fn(uri.uri, req->path.c_str(), req->path.size())
+            : (req->path == uri.uri);
+        if (!match) continue;
+        *pathFound = true;
+        if ((int)uri.method == r->method) return &uri;
+    }
+    return NULL;
+}
+
+static httpd_req_t * new_request(server_t * server, session_t * session, request_t * req) {
+    // The uri member is const, as in ESP-IDF, so the request cannot live on the stack
+    httpd_req_t * r = (httpd_req_t *)calloc(1, sizeof(httpd_req_t));
+    req->session = session;
+    req->remaining = 0;
+    req->status = HTTPD_200;
+    req->type = HTTPD_TYPE_TEXT;
+    req->headersSent = false;
+    req->failed = false;
+    r->handle = server;
+    r->aux = req;
+    r->sess_ctx = session->ctx;
+    r->free_ctx = session->free_ctx;
+    return r;
+}
+
+// A handler may have attached a context to the session
+static void end_request(session_t * session, httpd_req_t * r) {
+    if (r->sess_ctx != session->ctx) {
+        if (session->ctx) {
+            if (session->free_ctx) session->free_ctx(session->ctx);
+            else free(session->ctx);
+        }
+        session->ctx = r->sess_ctx;
+    }
+    session->free_ctx = r->free_ctx;
+    free(r);
+}
+
+static bool ws_handshake(httpd_req_t * r) {
+    char key[64];
+    if (httpd_req_get_hdr_value_str(r, "Sec-WebSocket-Key", key, sizeof(key)) != ESP_OK) return false;
+    uint8_t digest[20];
+    sha1(std::string(key) + "258EAFA5-E914-47DA-95CA-C5AB0DC85B11", digest);
+    std::string res = "HTTP/1.1 101 Switching Protocols\r\nUpgrade: websocket\r\nConnection: Upgrade\r\n"
+                      "Sec-WebSocket-Accept: " + base64(digest, 20) + "\r\n\r\n";
+    return send_all(((request_t *)r->aux)->session->fd, res.data(), res.size());
+}
+
+// Handle every complete WebSocket message waiting on the session; false when it should close
+static bool handle_ws_messages(server_t * server, session_t * session) {
+    std::string & in = session->input;
+    while (in.size() >= 2) {
+        const uint8_t * b = (const uint8_t *)in.data();
+        int opcode = b[0] & 0x0f;
+        bool masked = b[1] & 0x80;
+        uint64_t len = b[1] & 0x7f;
+        size_t head = 2;
+        if (len == 126) {
+            if (in.size() < 4) return true;
+            len = (b[2] << 8) | b[3];
+            head = 4;
+        } else if (len == 127) {
+            if (in.size() < 10) return true;
+            len = 0;
+            for (int i = 0; i < 8; i++) len = (len << 8) | b[2 + i];
+            head = 10;
+        }
+        uint8_t mask[4] = { 0, 0, 0, 0 };
+        if (masked) {
+            if (in.size() < head + 4) return true;
+            memcpy(mask, b + head, 4);
+            head += 4;
+        }
+        if (in.size() < head + len) return true;
+        std::string payload = in.substr(head, len);
+        in.erase(0, head + len);
+        for (size_t i = 0; i < payload.size(); i++) payload[i] ^= mask[i % 4];
+
+        if (!session->ws->handle_ws_control_frames) {
+            if (opcode == HTTPD_WS_TYPE_CLOSE) {
+                send_all(session->fd, "\x88\x00", 2);
+                return false;
+            }
+            if (opcode == HTTPD_WS_TYPE_PING) {
+                std::string pong = std::string("\x8a") + (char)payload.size() + payload;
+                send_all(session->fd, pong.data(), pong.size());
+                continue;
+            }
+            if (opcode == HTTPD_WS_TYPE_PONG) continue;
+        }
+
+        request_t req;
+        httpd_req_t * r = new_request(server, session, &req);
+        strcpy((char *)r->uri, session->ws->uri);
+        r->method = 0;
+        r->user_ctx = session->ws->user_ctx;
+        req.wsType = (httpd_ws_type_t)opcode;
+        req.wsPayload = payload;
+        esp_err_t res = session->ws->handler(r);
+        end_request(session, r);
+        if (res != ESP_OK) return false;
+    }
+    return true;
+}
+
+// Handle every complete request waiting on the session; false when it should close
+static bool handle_requests(server_t * server, session_t * session) {
+    while (true) {
+        if (session->ws) return handle_ws_messages(server, session);
+        request_t req;
+        httpd_req_t * r = new_request(server, session, &req);
+        if (!parse_request(server, session, r, &req)) {
+            free(r);
+            return true;
+        }
+
+        bool pathFound;
+        const httpd_uri_t * uri = find_handler(server, r, &pathFound);
+        esp_err_t res;
+        if (!uri) {
+            if (pathFound) {
+                req.status = "405 Method Not Allowed";
+                res = httpd_resp_send(r, "Request method for this URI is not handled by server", HTTPD_RESP_USE_STRLEN);
+            } else {
+                res = httpd_resp_send_err(r, HTTPD_404_NOT_FOUND, "This URI does not exist");
+            }
+        } else if (uri->is_websocket) {
+            res = ws_handshake(r) ? ESP_OK : httpd_resp_send_err(r, HTTPD_400_BAD_REQUEST, NULL);
+            if (res == ESP_OK) {
+                session->ws = uri;
+                r->user_ctx = uri->user_ctx;
+                res = uri->handler(r);
+            }
+        } else {
+            r->user_ctx = uri->user_ctx;
+            res = uri->handler(r);
+        }
+        end_request(session, r);
+
+        if ((res != ESP_OK) || req.failed) return false;
+        // Discard any body the handler did not read
+        if (req.remaining > 0) {
+            size_t n = min(req.remaining, session->input.size());
+            session->input.erase(0, n);
+            req.remaining -= n;
+            if (req.remaining > 0) return false;
+        }
+    }
+}
+
+static void * server_task(void * arg) {
+    server_t * server = (server_t *)arg;
+    while (true) {
+        fd_set readFds;
+        FD_ZERO(&readFds);
+        FD_SET(server->listenFd, &readFds);
+        FD_SET(server->wakeFds[0], &readFds);
+        int maxFd = max(server->listenFd, server->wakeFds[0]);
+        for (size_t i = 0; i < server->sessions.size(); i++) {
+            FD_SET(server->sessions[i]->fd, &readFds);
+            maxFd = max(maxFd, server->sessions[i]->fd);
+        }
+        if (select(maxFd + 1, &readFds, NULL, NULL, NULL) < 0) {
+            if (errno == EINTR) continue;
+            perror("httpd select");
+            return NULL;
+        }
+
+        if (FD_ISSET(server->wakeFds[0], &readFds)) {
+            server_msg_t msg;
+            if (read(server->wakeFds[0], &msg, sizeof(msg)) == sizeof(msg)) {
+                if (msg.work) {
+                    msg.work(msg.arg);
+                } else {
+                    session_t * session = find_session(server, msg.fd);
+                    if (session) close_session(server, session);
+                }
+            }
+            continue;
+        }
+
+        if (FD_ISSET(server->listenFd, &readFds)) {
+            int fd = accept(server->listenFd, NULL, NULL);
+            if (fd >= 0) {
+                if (server->sessions.size() >= server->config.max_open_sockets) {
+                    close(fd);
+                } else {
+                    struct timeval tv = { server->config.send_wait_timeout, 0 };
+                    setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+                    tv.tv_sec = server->config.recv_wait_timeout;
+                    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+                    int one = 1;
+                    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+                    session_t * session = new session_t;
+                    session->fd = fd;
+                    session->ctx = NULL;
+                    session->free_ctx = NULL;
+                    session->ws = NULL;
+                    server->sessions.push_back(session);
+                }
+            }
+        }
+
+        // Copy the list; handlers may close sessions
+        std::vector<session_t *> ready;
+        for (size_t i = 0; i < server->sessions.size(); i++) {
+            if (FD_ISSET(server->sessions[i]->fd, &readFds)) ready.push_back(server->sessions[i]);
+        }
+        for (size_t i = 0; i < ready.size(); i++) {
+            session_t * session = ready[i];
+            char buf[2048];
+            ssize_t n = recv(session->fd, buf, sizeof(buf), MSG_DONTWAIT);
+            if ((n < 0) && ((errno == EAGAIN) || (errno == EINTR))) continue;
+            if (n <= 0) {
+                close_session(server, session);
+                continue;
+            }
+            session->input.append(buf, n);
+            if (!handle_requests(server, session)) close_session(server, session);
+        }
+    }
+    return NULL;
+}
+
+esp_err_t httpd_start(httpd_handle_t * handle, const httpd_config_t * config) {
+    server_t * server = new server_t;
+    server->config = *config;
+    server->listenFd = socket(AF_INET, SOCK_STREAM, 0);
+    int one = 1;
+    setsockopt(server->listenFd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    addr.sin_port = htons(config->server_port);
+    if ((bind(server->listenFd, (struct sockaddr *)&addr, sizeof(addr)) < 0) ||
+        (listen(server->listenFd, config->backlog_conn) < 0) || (pipe(server->wakeFds) < 0)) {
+        perror("httpd_start");
+        close(server->listenFd);
+        delete server;
+        return ESP_ERR_HTTPD_TASK;
+    }
+    if (pthread_create(&server->thread, NULL, server_task, server) != 0) {
+        close(server->listenFd);
+        delete server;
+        return ESP_ERR_HTTPD_TASK;
+    }
+    pthread_detach(server->thread);
+    *handle = server;
+    return ESP_OK;
+}
+
+esp_err_t httpd_stop(httpd_handle_t handle) {
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+esp_err_t httpd_register_uri_handler(httpd_handle_t handle, const httpd_uri_t * uri_handler) {
+    server_t * server = (server_t *)handle;
+    if (server->uris.size() >= server->config.max_uri_handlers) return ESP_ERR_HTTPD_HANDLERS_FULL;
+    for (size_t i = 0; i < server->uris.size(); i++) {
+        if (!strcmp(server->uris[i].uri, uri_handler->uri) && (server->uris[i].method == uri_handler->method)) {
+            return ESP_ERR_HTTPD_HANDLER_EXISTS;
+        }
+    }
+    server->uris.push_back(*uri_handler);
+    return ESP_OK;
+}
+
+bool httpd_uri_match_wildcard(const char * reference_uri, const char * uri_to_match, size_t match_upto) {
+    size_t len = strlen(reference_uri);
+    if (len && (reference_uri[len - 1] == '*')) {
+        return (match_upto >= len - 1) && !strncmp(reference_uri, uri_to_match, len - 1);
+    }
+    return (match_upto == len) && !strncmp(reference_uri, uri_to_match, len);
+}
+
+size_t httpd_req_get_url_query_len(httpd_req_t * r) {
+    return ((request_t *)r->aux)->query.size();
+}
+
+esp_err_t httpd_req_get_url_query_str(httpd_req_t * r, char * buf, size_t buf_len) {
+    const std::string & query = ((request_t *)r->aux)->query;
+    if (query.empty()) return ESP_ERR_NOT_FOUND;
+    strncpy(buf, query.c_str(), buf_len);
+    if (query.size() >= buf_len) {
+        buf[buf_len - 1] = 0;
+        return ESP_ERR_HTTPD_RESULT_TRUNC;
+    }
+    return ESP_OK;
+}
+
+esp_err_t httpd_query_key_value(const char * qry, const char * key, char * val, size_t val_size) {
+    size_t keyLen = strlen(key);
+    const char * p = qry;
+    while (p && *p) {
+        const char * end = strchr(p, '&');
+        if (!end) end = p + strlen(p);
+        if (!strncmp(p, key, keyLen) && (p[keyLen] == '=')) {
+            const char * value = p + keyLen + 1;
+            size_t len = end - value;
+            size_t copy = min(len, val_size - 1);
+            memcpy(val, value, copy);
+            val[copy] = 0;
+            return (len >= val_size) ? ESP_ERR_HTTPD_RESULT_TRUNC : ESP_OK;
+        }
+        p = *end ? end + 1 : NULL;
+    }
+    return ESP_ERR_NOT_FOUND;
+}
+
+size_t httpd_req_get_hdr_value_len(httpd_req_t * r, const char * field) {
+    request_t * req = (request_t *)r->aux;
+    for (size_t i = 0; i < req->headers.size(); i++) {
+        if (!strcasecmp(req->headers[i].first.c_str(), field)) return req->headers[i].second.size();
+    }
+    return 0;
+}
+
+esp_err_t httpd_req_get_hdr_value_str(httpd_req_t * r, const char * field, char * val, size_t val_size) {
+    request_t * req = (request_t *)r->aux;
+    for (size_t i = 0; i < req->headers.size(); i++) {
+        if (!strcasecmp(req->headers[i].first.c_str(), field)) {
+            const std::string & value = req->headers[i].second;
+            strncpy(val, value.c_str(), val_size);
+            if (value.size() >= val_size) {
+                val[val_size - 1] = 0;
+                return ESP_ERR_HTTPD_RESULT_TRUNC;
+            }
+            return ESP_OK;
+        }
+    }
+    return ESP_ERR_NOT_FOUND;
+}
+
+int httpd_req_recv(httpd_req_t * r, char * buf, size_t buf_len) {
+    request_t * req = (request_t *)r->aux;
+    size_t want = min(buf_len, req->remaining);
+    if (want == 0) return 0;
+    std::string & input = req->session->input;
+    if (!input.empty()) {
+        size_t n = min(want, input.size());
+        memcpy(buf, input.data(), n);
+        input.erase(0, n);
+        req->remaining -= n;
+        return n;
+    }
+    ssize_t n = recv(req->session->fd, buf, want, 0);
+    if (n < 0) return ((errno == EAGAIN) || (errno == EWOULDBLOCK)) ? -3 : -1;  // HTTPD_SOCK_ERR_TIMEOUT / FAIL
+    req->remaining -= n;
+    return n;
+}
+
+int httpd_req_to_sockfd(httpd_req_t * r) {
+    return ((request_t *)r->aux)->session->fd;
+}
+
+esp_err_t httpd_resp_set_status(httpd_req_t * r, const char * status) {
+    ((request_t *)r->aux)->status = status;
+    return ESP_OK;
+}
+
+esp_err_t httpd_resp_set_type(httpd_req_t * r, const char * type) {
+    ((request_t *)r->aux)->type = type;
+    return ESP_OK;
+}
+
+esp_err_t httpd_resp_set_hdr(httpd_req_t * r, const char * field, const char * value) {
+    request_t * req = (request_t *)r->aux;
+    if (req->respHeaders.size() >= ((server_t *)r->handle)->config.max_resp_headers) return ESP_ERR_HTTPD_RESP_HDR;
+    req->respHeaders.push_back(std::make_pair(field, value));
+    return ESP_OK;
+}
+
+esp_err_t httpd_resp_send(httpd_req_t * r, const char * buf, ssize_t buf_len) {
+    request_t * req = (request_t *)r->aux;
+    if (!buf) buf_len = 0;
+    else if (buf_len == HTTPD_RESP_USE_STRLEN) buf_len = strlen(buf);
+    char length[40];
+    sprintf(length, "Content-Length: %u\r\n", (unsigned)buf_len);
+    if (!send_headers(r, length) || !send_all(req->session->fd, buf, buf_len)) {
+        req->failed = true;
+        return ESP_ERR_HTTPD_RESP_SEND;
+    }
+    return ESP_OK;
+}
+
+esp_err_t httpd_resp_send_chunk(httpd_req_t * r, const char * buf, ssize_t buf_len) {
+    request_t * req = (request_t *)r->aux;
+    if (!buf) buf_len = 0;
+    else if (buf_len == HTTPD_RESP_USE_STRLEN) buf_len = strlen(buf);
+    if (!req->headersSent && !send_headers(r, "Transfer-Encoding: chunked\r\n")) {
+        req->failed = true;
+        return ESP_ERR_HTTPD_RESP_SEND;
+    }
+    char size[16];
+    int n = sprintf(size, "%x\r\n", (unsigned)buf_len);
+    if (!send_all(req->session->fd, size, n) || !send_all(req->session->fd, buf, buf_len) ||
+        !send_all(req->session->fd, "\r\n", 2)) {
+        req->failed = true;
+        return ESP_ERR_HTTPD_RESP_SEND;
+    }
+    return ESP_OK;
+}
+
+// Raw bytes on the socket; the handler has written its own status line and headers
+int httpd_send(httpd_req_t * r, const char * buf, size_t buf_len) {
+    request_t * req = (request_t *)r->aux;
+    req->headersSent = true;
+    if (!send_all(req->session->fd, buf, buf_len)) {
+        req->failed = true;
+        return HTTPD_SOCK_ERR_FAIL;
+    }
+    return (int)buf_len;
+}
+
+esp_err_t httpd_resp_send_err(httpd_req_t * r, httpd_err_code_t error, const char * msg) {
+    const char * status;
+    const char * text;
+    switch (error) {
+        case HTTPD_400_BAD_REQUEST: status = HTTPD_400; text = "Bad request"; break;
+        case HTTPD_404_NOT_FOUND: status = HTTPD_404; text = "This URI does not exist"; break;
+        case HTTPD_408_REQ_TIMEOUT: status = HTTPD_408; text = "Server closed this connection"; break;
+        default: status = HTTPD_500; text = "Internal Server Error"; break;
+    }
+    request_t * req = (request_t *)r->aux;
+    req->status = status;
+    req->type = HTTPD_TYPE_TEXT;
+    esp_err_t res = httpd_resp_send(r, msg ? msg : text, HTTPD_RESP_USE_STRLEN);
+    return (res == ESP_OK) ? ESP_FAIL : res;
+}
+
+esp_err_t httpd_ws_recv_frame(httpd_req_t * r, httpd_ws_frame_t * pkt, size_t max_len) {
+    request_t * req = (request_t *)r->aux;
+    if (!req->session->ws) return ESP_ERR_INVALID_STATE;
+    pkt->final = true;
+    pkt->fragmented = false;
+    pkt->type = req->wsType;
+    pkt->len = req->wsPayload.size();
+    if (max_len == 0) return ESP_OK;
+    if (!pkt->payload || (max_len < pkt->len)) return ESP_ERR_INVALID_SIZE;
+    memcpy(pkt->payload, req->wsPayload.data(), pkt->len);
+    return ESP_OK;
+}
+
+int httpd_socket_send(httpd_handle_t hd, int sockfd, const char * buf, size_t buf_len, int flags) {
+    ssize_t n = send(sockfd, buf, buf_len, flags | MSG_NOSIGNAL);
+    return (n < 0) ? -1 : n;
+}
+
+int httpd_socket_recv(httpd_handle_t hd, int sockfd, char * buf, size_t buf_len, int flags) {
+    ssize_t n = recv(sockfd, buf, buf_len, flags);
+    return (n < 0) ? -1 : n;
+}
+
+esp_err_t httpd_sess_trigger_close(httpd_handle_t handle, int sockfd) {
+    server_msg_t msg = { NULL, NULL, sockfd };
+    post((server_t *)handle, msg);
+    return ESP_OK;
+}
+
+// Only safe from the server thread, as on the ESP32
+void * httpd_sess_get_ctx(httpd_handle_t handle, int sockfd) {
+    session_t * session = find_session((server_t *)handle, sockfd);
+    return session ? session->ctx : NULL;
+}
+
+void httpd_sess_set_ctx(httpd_handle_t handle, int sockfd, void * ctx, httpd_free_ctx_fn_t free_fn) {
+    session_t * session = find_session((server_t *)handle, sockfd);
+    if (!session) return;
+    session->ctx = ctx;
+    session->free_ctx = free_fn;
+}
+
+esp_err_t httpd_queue_work(httpd_handle_t handle, httpd_work_fn_t work, void * arg) {
+    server_msg_t msg = { work, arg, -1 };
+    post((server_t *)handle, msg);
+    return ESP_OK;
+}
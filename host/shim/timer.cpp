@@ -0,0 +1,129 @@
+//
+// Host build: esp_timer one-shot and periodic timers.
+//
+// One dispatch thread sleeps until the earliest armed timer is due and runs
+// the callbacks in turn, so callbacks never run concurrently with each other.
+//
+
+#include <pthread.h>
+#include <time.h>
+#include <vector>
+
+#include <esp_timer.h>
+
+struct esp_timer {
+    esp_timer_cb_t callback;
+    void * arg;
+    int64_t due;            // esp_timer time the callback is due, 0 = not armed
+    uint64_t period;        // 0 for one-shot timers
+};
+
+static pthread_mutex_t timerLock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t timerCond;
+static std::vector<esp_timer *> timers;
+static bool dispatching = false;
+
+static void * timer_dispatch(void * arg) {
+    pthread_mutex_lock(&timerLock);
+    while (true) {
+        esp_timer * next = NULL;
+        for (size_t i = 0; i < timers.size(); i++) {
+            if (timers[i]->due && (!next || (timers[i]->due < next->due))) next = timers[i];
+        }
+        int64_t now = esp_timer_get_time();
+        if (!next) {
+            pthread_cond_wait(&timerCond, &timerLock);
+        } else if (next->due > now) {
+            struct timespec ts = { (time_t)(next->due / 1000000), (long)(next->due % 1000000) * 1000 };
+            pthread_cond_timedwait(&timerCond, &timerLock, &ts);
+        } else {
+            next->due = next->period ? next->due + next->period : 0;
+            esp_timer_cb_t callback = next->callback;
+            void * cbArg = next->arg;
+            pthread_mutex_unlock(&timerLock);
+            callback(cbArg);
+            pthread_mutex_lock(&timerLock);
+        }
+    }
+    return NULL;
+}
+
+esp_err_t esp_timer_create(const esp_timer_create_args_t * args, esp_timer_handle_t * out_handle) {
+    if (!args || !args->callback || !out_handle) return ESP_ERR_INVALID_ARG;
+    esp_timer * timer = new esp_timer();
+    timer->callback = args->callback;
+    timer->arg = args->arg;
+    pthread_mutex_lock(&timerLock);
+    if (!dispatching) {
+        // Timed waits are against the monotonic clock, like esp_timer_get_time()
+        pthread_condattr_t attr;
+        pthread_condattr_init(&attr);
+        pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+        pthread_cond_init(&timerCond, &attr);
+        pthread_t thread;
+        pthread_create(&thread, NULL, timer_dispatch, NULL);
+        pthread_detach(thread);
+        dispatching = true;
+    }
+    timers.push_back(timer);
+    pthread_mutex_unlock(&timerLock);
+    *out_handle = timer;
+    return ESP_OK;
+}
+
+static esp_err_t timer_start(esp_timer_handle_t timer, uint64_t timeout, uint64_t period) {
+    if (!timer) return ESP_ERR_INVALID_ARG;
+    pthread_mutex_lock(&timerLock);
+    if (timer->due) {
+        pthread_mutex_unlock(&timerLock);
+        return ESP_ERR_INVALID_STATE;
+    }
+    // A zero timeout still has to be told apart from a disarmed timer
+    timer->due = esp_timer_get_time() + (int64_t)timeout + (timeout ? 0 : 1);
+    timer->period = period;
+    pthread_cond_signal(&timerCond);
+    pthread_mutex_unlock(&timerLock);
+    return ESP_OK;
+}
+
+esp_err_t esp_timer_start_once(esp_timer_handle_t timer, uint64_t timeout_us) {
+    return timer_start(timer, timeout_us, 0);
+}
+
+esp_err_t esp_timer_start_periodic(esp_timer_handle_t timer, uint64_t period) {
+    return timer_start(timer, period, period);
+}
+
+esp_err_t esp_timer_stop(esp_timer_handle_t timer) {
+    if (!timer) return ESP_ERR_INVALID_ARG;
+    pthread_mutex_lock(&timerLock);
+    esp_err_t res = timer->due ? ESP_OK : ESP_ERR_INVALID_STATE;
+    timer->due = 0;
+    pthread_mutex_unlock(&timerLock);
+    return res;
+}
+
+esp_err_t esp_timer_delete(esp_timer_handle_t timer) {
+    if (!timer) return ESP_ERR_INVALID_ARG;
+    pthread_mutex_lock(&timerLock);
+    if (timer->due) {
+        pthread_mutex_unlock(&timerLock);
+        return ESP_ERR_INVALID_STATE;
+    }
+    for (size_t i = 0; i < timers.size(); i++) {
+        if (timers[i] == timer) {
+            timers.erase(timers.begin() + i);
+            break;
+        }
+    }
+    pthread_mutex_unlock(&timerLock);
+    delete timer;
+    return ESP_OK;
+}
+
+bool esp_timer_is_active(esp_timer_handle_t timer) {
+    pthread_mutex_lock(&timerLock);
+    bool active = timer && timer->due;
+    pthread_mutex_unlock(&timerLock);
+    return active;
+}
@@ -211,6 +211,26 @@ const uint8_t index_simple_html[] = R"=====(<!doctype html>
         startStream();
       })
 
+    // keep the controls in step with changes made elsewhere (other browsers, scripts)
+    const subscribe = () => {
+      const events = new EventSource(`${baseHost}/events`)
+      events.addEventListener('status', function (event) {
+        const state = JSON.parse(event.data)
+        document
+          .querySelectorAll('.action-setting')
+          .forEach(el => {
+            if (el !== document.activeElement && state[el.id] !== undefined) {
+              updateValue(el, state[el.id], false)
+            }
+          })
+      })
+      events.onerror = () => {
+        // the browser retries by itself unless the connection was refused or stopped
+        if (events.readyState === EventSource.CLOSED) setTimeout(subscribe, 5000)
+      }
+    }
+    if (window.EventSource) subscribe()
+
     // Put some helpful text on the 'Still' button
     stillButton.setAttribute("title", `Capture a still image :: ${baseHost}/capture`);
 
@@ -329,7 +349,7 @@ const uint8_t streamviewer_html[] = R"=====(<!doctype html>
         overflow:hidden;
       }
 
-      img {
+      img, canvas {
         object-fit: contain;
         display: block;
         margin: 0px;
@@ -338,6 +358,18 @@ const uint8_t streamviewer_html[] = R"=====(<!doctype html>
         height: 100vh;
       }
 
+      #stats {
+        position: absolute;
+        top: 0.5em;
+        left: 0.5em;
+        padding: 0.3em 0.5em;
+        background: rgba(0,0,0,0.6);
+        font-family: monospace;
+        font-size: 12px;
+        white-space: pre;
+        cursor: pointer;
+      }
+
       .loader {
         border: 0.5em solid #f3f3f3;
         border-top: 0.5em solid #000000;
@@ -371,6 +403,8 @@ const uint8_t streamviewer_html[] = R"=====(<!doctype html>
         <div id="stream_url" class="action-setting hidden"></div>
       </div>
       <img id="stream" src="">
+      <canvas id="canvas" style="display: none;"></canvas>
+      <div id="stats" style="display: none;" title="Click to hide"></div>
     </section>
   </body>
 
@@ -381,8 +415,15 @@ const uint8_t streamviewer_html[] = R"=====(<!doctype html>
 
     const rotate = document.getElementById('rotate')
     const stream = document.getElementById('stream')
+    const canvas = document.getElementById('canvas')
+    const stats = document.getElementById('stats')
     const spinner = document.getElementById('wait-settings')
 
+    // The WebSocket viewer is used where the browser can decode frames off-screen;
+    // add '?mjpeg' to the address to force the plain MJPEG stream
+    const useSocket = window.WebSocket && window.createImageBitmap &&
+                      !new URLSearchParams(window.location.search).has('mjpeg')
+
     const updateValue = (el, value, updateRemote) => {
       updateRemote = updateRemote == null ? true : updateRemote
       let initialValue
@@ -401,6 +442,7 @@ const uint8_t streamviewer_html[] = R"=====(<!doctype html>
         if(el.id === "cam_name"){
           window.document.title = value;
           stream.setAttribute("title", value + "\n(doubleclick for fullscreen)");
+          canvas.setAttribute("title", value + "\n(doubleclick for fullscreen)");
           console.log('Name set to: ' + value);
         } else if(el.id === "rotate"){
           rotate.value = value;
@@ -429,31 +471,129 @@ const uint8_t streamviewer_html[] = R"=====(<!doctype html>
       })
 
     const startStream = () => {
+      if (useSocket) {
+        startSocket();
+      } else {
+        startMjpeg();
+      }
+    }
+
+    const startMjpeg = () => {
+      canvas.style.display = `none`;
       stream.src = streamURL;
       stream.style.display = `block`;
     }
 
+    // Each binary message is a 24 byte little endian header (sequence number,
+    // JPEG size, capture time and send time in camera microseconds) and the
+    // JPEG. We grant credit for one frame at a time, with two in flight, so
+    // frames never queue up in the network and what is shown is always fresh.
+    // A close from the camera (1000, or 1001 when /stop is used) ends the
+    // stream; only a dropped connection (1006) is retried, backing off from
+    // one second to thirty while the camera stays away.
+    let socketWorked = false
+    let retryDelay = 1000
+
+    const startSocket = () => {
+      const ws = new WebSocket(streamURL.replace(/^http/, 'ws') + 'ws')
+      const context = canvas.getContext('2d')
+      ws.binaryType = 'arraybuffer'
+      let frames = 0
+      let lastSeq = 0
+      let skipped = 0
+      let bestTransit = Infinity
+      let tally = { start: performance.now(), frames: 0, age: 0, transit: 0, decode: 0 }
+
+      ws.onopen = () => {
+        stream.style.display = `none`;
+        canvas.style.display = `block`;
+        stats.style.display = `block`;
+        ws.send('2')
+      }
+      ws.onmessage = (event) => {
+        const received = performance.now()
+        const header = new DataView(event.data, 0, 24)
+        const seq = header.getUint32(0, true)
+        const size = header.getUint32(4, true)
+        const captured = header.getUint32(8, true) / 1000 + header.getUint32(12, true) * 4294967.296
+        const sent = header.getUint32(16, true) / 1000 + header.getUint32(20, true) * 4294967.296
+        // The two clocks are unrelated; the quickest delivery seen so far stands in for the offset
+        bestTransit = Math.min(bestTransit, received - sent)
+        if (lastSeq && seq > lastSeq + 1) skipped += seq - lastSeq - 1
+        lastSeq = seq
+        createImageBitmap(new Blob([new Uint8Array(event.data, 24, size)], {type: 'image/jpeg'}))
+          .then(bitmap => {
+            if (canvas.width !== bitmap.width) canvas.width = bitmap.width
+            if (canvas.height !== bitmap.height) canvas.height = bitmap.height
+            context.drawImage(bitmap, 0, 0)
+            bitmap.close()
+            const shown = performance.now()
+            frames++
+            socketWorked = true
+            retryDelay = 1000
+            tally.frames++
+            tally.age += sent - captured
+            tally.transit += received - sent - bestTransit
+            tally.decode += shown - received
+            if (shown - tally.start >= 1000) {
+              const n = tally.frames
+              stats.innerHTML = `${(n * 1000 / (shown - tally.start)).toFixed(1)} fps, frame ${seq}, skipped ${skipped}\n` +
+                `queued on camera ${(tally.age / n).toFixed(1)} ms\n` +
+                `network above best ${(tally.transit / n).toFixed(1)} ms\n` +
+                `decode and draw ${(tally.decode / n).toFixed(1)} ms`
+              tally = { start: shown, frames: 0, age: 0, transit: 0, decode: 0 }
+            }
+          })
+          .catch(err => console.log('Frame ' + seq + ' not shown: ' + err))
+          .finally(() => {
+            if (ws.readyState === WebSocket.OPEN) ws.send('1')
+          })
+      }
+      ws.onclose = (event) => {
+        console.log('WebSocket closed with code ' + event.code + ' after ' + frames + ' frames')
+        // Fall back to MJPEG if the socket never worked
+        if (!socketWorked) {
+          stats.style.display = `none`;
+          startMjpeg();
+        } else if (event.code === 1006) {
+          console.log('Reconnecting in ' + retryDelay + ' ms')
+          setTimeout(startSocket, retryDelay)
+          retryDelay = Math.min(retryDelay * 2, 30000)
+        } else {
+          stats.innerHTML = `Stream ended (${event.code})`
+        }
+      }
+    }
+
+    stats.onclick = () => {
+      stats.style.display = `none`;
+    }
+
     const applyRotation = () => {
       rot = rotate.value;
       if (rot == -90) {
         stream.style.transform = `rotate(-90deg)`;
+        canvas.style.transform = `rotate(-90deg)`;
       } else if (rot == 90) {
         stream.style.transform = `rotate(90deg)`;
+        canvas.style.transform = `rotate(90deg)`;
       }
       console.log('Rotation ' + rot + ' applied');
     }
 
-    stream.ondblclick = () => {
-      if (stream.requestFullscreen) {
-        stream.requestFullscreen();
-      } else if (stream.mozRequestFullScreen) { /* Firefox */
-        stream.mozRequestFullScreen();
-      } else if (stream.webkitRequestFullscreen) { /* Chrome, Safari and Opera */
-        stream.webkitRequestFullscreen();
-      } else if (stream.msRequestFullscreen) { /* IE/Edge */
-        stream.msRequestFullscreen();
+    const fullscreen = (el) => {
+      if (el.requestFullscreen) {
+        el.requestFullscreen();
+      } else if (el.mozRequestFullScreen) { /* Firefox */
+        el.mozRequestFullScreen();
+      } else if (el.webkitRequestFullscreen) { /* Chrome, Safari and Opera */
+        el.webkitRequestFullscreen();
+      } else if (el.msRequestFullscreen) { /* IE/Edge */
+        el.msRequestFullscreen();
       }
     }
+    stream.ondblclick = () => fullscreen(stream)
+    canvas.ondblclick = () => fullscreen(canvas)
   })
   </script>
 </html>)=====";
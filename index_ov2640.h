@@ -465,6 +465,26 @@ const uint8_t index_ov2640_html[] = R"=====(<!doctype html>
         //startStream();
       })
 
+    // keep the controls in step with changes made elsewhere (other browsers, scripts)
+    const subscribe = () => {
+      const events = new EventSource(`${baseHost}/events`)
+      events.addEventListener('status', function (event) {
+        const state = JSON.parse(event.data)
+        document
+          .querySelectorAll('.default-action')
+          .forEach(el => {
+            if (el !== document.activeElement && state[el.id] !== undefined) {
+              updateValue(el, state[el.id], false)
+            }
+          })
+      })
+      events.onerror = () => {
+        // the browser retries by itself unless the connection was refused or stopped
+        if (events.readyState === EventSource.CLOSED) setTimeout(subscribe, 5000)
+      }
+    }
+    if (window.EventSource) subscribe()
+
     // Put some helpful text on the 'Still' button
     stillButton.setAttribute("title", `Capture a still image :: ${baseHost}/capture`);
 
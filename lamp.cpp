@@ -0,0 +1,58 @@
+//
+// Illumination lamp PWM.
+//
+
+#include <driver/ledc.h>
+#include <Arduino.h>
+
+#include "lamp.h"
+
+#define LAMP_DUTY(v) lamp_pwm(v, LAMP_PWM_RESOLUTION)
+#define LAMP_ROW(v) LAMP_DUTY(v), LAMP_DUTY(v + 1), LAMP_DUTY(v + 2), LAMP_DUTY(v + 3), LAMP_DUTY(v + 4), \
+                    LAMP_DUTY(v + 5), LAMP_DUTY(v + 6), LAMP_DUTY(v + 7), LAMP_DUTY(v + 8), LAMP_DUTY(v + 9)
+
+static constexpr uint16_t lampTable[101] = {
+    LAMP_ROW(0), LAMP_ROW(10), LAMP_ROW(20), LAMP_ROW(30), LAMP_ROW(40),
+    LAMP_ROW(50), LAMP_ROW(60), LAMP_ROW(70), LAMP_ROW(80), LAMP_ROW(90), LAMP_DUTY(100)
+};
+
+static_assert(lampTable[0] == 0, "lamp table must start at off");
+static_assert(lampTable[100] == (1 << LAMP_PWM_RESOLUTION) - 1, "lamp table must end at full power");
+
+static int lampChannel = -1;
+static bool fadeInstalled = false;
+
+// Arduino numbers LEDC channels across both speed groups, eight to a group
+static ledc_mode_t channel_mode(int channel) {
+#if defined(SOC_LEDC_SUPPORT_HS_MODE) && SOC_LEDC_SUPPORT_HS_MODE
+    return (channel < 8) ? LEDC_HIGH_SPEED_MODE : LEDC_LOW_SPEED_MODE;
+#else
+    return LEDC_LOW_SPEED_MODE;
+#endif
+}
+
+void lampInit(int pin, int channel) {
+    ledcSetup(channel, LAMP_PWM_FREQ, LAMP_PWM_RESOLUTION);  // configure LED PWM channel
+    ledcAttachPin(pin, channel);                             // attach the GPIO pin to the channel
+    lampChannel = channel;
+    fadeInstalled = (ledc_fade_func_install(0) == ESP_OK);
+    if (!fadeInstalled) Serial.println("LAMP: hardware fade unavailable; lamp changes will be immediate");
+}
+
+uint32_t lampDuty(int percent) {
+    return lampTable[constrain(percent, 0, 100)];
+}
+
+// Set the lamp, over 'fadeTime' ms or at once if 0. A new change waits for a running fade to finish.
+void lampWrite(int percent, uint32_t fadeTime) {
+    if (lampChannel < 0) return;
+    uint32_t duty = lampDuty(percent);
+    if (!fadeInstalled) {
+        ledcWrite(lampChannel, duty);
+        return;
+    }
+    ledc_mode_t mode = channel_mode(lampChannel);
+    ledc_channel_t channel = (ledc_channel_t)(lampChannel % 8);
+    if (fadeTime) ledc_set_fade_time_and_start(mode, channel, duty, fadeTime, LEDC_FADE_NO_WAIT);
+    else ledc_set_duty_and_update(mode, channel, duty, 0);
+}
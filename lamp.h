@@ -0,0 +1,37 @@
+//
+// Illumination lamp PWM.
+//
+// Lamp values are percentages, mapped onto PWM duty by the curve in
+// Docs/linearled so that equal steps look like equal changes in brightness.
+// The mapping is a table built by the compiler for the PWM resolution in use;
+// fades are run by the LEDC hardware, so nothing here blocks or does float math.
+//
+
+#pragma once
+
+#include <stdint.h>
+
+#define LAMP_PWM_FREQ 50000     // 50K pwm frequency
+#define LAMP_PWM_RESOLUTION 9   // duty cycle bit range
+
+// How long the automatic lamp takes to fade on or off (ms)
+#define LAMP_FADE_TIME 250
+
+// duty = (2^(1 + percent/50) - 2) / 6 * pwmMax, as printed by Docs/linearled/linearled.c.
+// 2^x is summed from its Taylor series so that the whole curve is constexpr;
+// host/lampcheck.cpp compares it with linearled for every resolution it takes.
+static constexpr double lamp_exp_series(double y, int n, double term) {
+    return (n > 30) ? 0 : term + lamp_exp_series(y, n + 1, term * y / (n + 1));
+}
+
+static constexpr double lamp_curve(int percent) {
+    return (2 * lamp_exp_series(percent * 0.02 * 0.69314718055994531, 0, 1.0) - 2) / 6;
+}
+
+static constexpr uint16_t lamp_pwm(int percent, int bits) {
+    return (uint16_t)(lamp_curve(percent) * ((1 << bits) - 1) + 0.5);
+}
+
+extern void lampInit(int pin, int channel);
+extern uint32_t lampDuty(int percent);
+extern void lampWrite(int percent, uint32_t fadeTime);
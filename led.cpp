@@ -0,0 +1,77 @@
+//
+// Status LED effects that run in the background.
+//
+
+#include <esp_timer.h>
+#include <Arduino.h>
+
+#include "led.h"
+
+static esp_timer_handle_t ledTimer = NULL;
+static portMUX_TYPE ledMux = portMUX_INITIALIZER_UNLOCKED;
+static int ledPin = -1;
+static uint8_t ledOn;
+static uint8_t ledOff;
+
+// Pattern state; only the timer callback drives the pin
+static int flashesLeft = 0;
+static uint32_t flashOn = 0;
+static uint32_t flashOff = 0;
+static bool lit = false;
+
+static void led_step(void * arg) {
+    uint32_t next = 0;
+    portENTER_CRITICAL(&ledMux);
+    if (lit) {
+        lit = false;
+        if (flashesLeft > 0) next = max(flashOff, (uint32_t)1);
+    } else if (flashesLeft > 0) {
+        lit = true;
+        flashesLeft--;
+        next = flashOn;
+    }
+    bool on = lit;
+    portEXIT_CRITICAL(&ledMux);
+
+    digitalWrite(ledPin, on ? ledOn : ledOff);
+    if (next) esp_timer_start_once(ledTimer, (uint64_t)next * 1000);
+}
+
+void ledInit(int pin, uint8_t on, uint8_t off) {
+    if (ledTimer) return;
+    const esp_timer_create_args_t args = {
+        .callback = led_step,
+        .arg = NULL,
+        .dispatch_method = ESP_TIMER_TASK,
+        .name = "led"
+    };
+    if (esp_timer_create(&args, &ledTimer) != ESP_OK) {
+        Serial.println("LED: timer create failed; effects disabled");
+        ledTimer = NULL;
+        return;
+    }
+    ledPin = pin;
+    ledOn = on;
+    ledOff = off;
+}
+
+// Flash 'count' times, on for 'onTime' then off for 'offTime' ms
+void ledBlink(int count, uint32_t onTime, uint32_t offTime) {
+    if (!ledTimer || (count <= 0)) return;
+    portENTER_CRITICAL(&ledMux);
+    flashesLeft = count;
+    flashOn = max(onTime, (uint32_t)1);
+    flashOff = offTime;
+    portEXIT_CRITICAL(&ledMux);
+    // Restart the timer so the new pattern begins now, from a dark LED if one was lit
+    esp_timer_stop(ledTimer);
+    esp_timer_start_once(ledTimer, 0);
+}
+
+void ledFlash(uint32_t flashTime) {
+    ledBlink(1, flashTime, 0);
+}
+
+void ledDoubleFlash(uint32_t flashTime) {
+    ledBlink(2, flashTime, flashTime);
+}
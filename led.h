@@ -0,0 +1,16 @@
+//
+// Status LED effects that run in the background.
+//
+// Effects are stepped by an esp_timer, so request handlers can trigger a
+// flash or blink pattern and return straight away. Starting an effect
+// replaces whatever pattern was still running.
+//
+
+#pragma once
+
+#include <stdint.h>
+
+extern void ledInit(int pin, uint8_t on, uint8_t off);
+extern void ledBlink(int count, uint32_t onTime, uint32_t offTime);
+extern void ledFlash(uint32_t flashTime);
+extern void ledDoubleFlash(uint32_t flashTime);
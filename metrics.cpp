@@ -0,0 +1,264 @@
+//
+// Counters and histograms for the /metrics endpoint (Prometheus text format).
+//
+// Histograms use fixed buckets and are updated under a spinlock, so the
+// capture and send paths never block on a scrape. Request counts and times
+// are gathered by wrapping each URI handler before it is registered; the
+// wrapper's record travels in the URI's user_ctx.
+//
+
+#include <esp_http_server.h>
+#include <esp_timer.h>
+#include <Arduino.h>
+#include <WiFi.h>
+
+#include "metrics.h"
+#include "framering.h"
+
+// These are defined in the main .ino file
+extern int8_t streamCount;
+extern unsigned long streamsServed;
+extern unsigned long imagesServed;
+extern bool accesspoint;
+
+// Most buckets in any histogram, and most wrapped handlers
+#define METRICS_BUCKETS 8
+#define METRICS_HANDLERS 20
+
+// Output is sent in chunks of about this size; no single line may be longer than METRICS_LINE
+#define METRICS_CHUNK 1024
+#define METRICS_LINE 256
+
+typedef struct {
+    const char * name;
+    const char * help;
+    float scale;                          // printed values are divided by this
+    uint32_t bounds[METRICS_BUCKETS];     // upper bounds, ascending, 0 terminated
+    uint32_t counts[METRICS_BUCKETS + 1]; // the last bucket is +Inf
+    uint64_t sum;
+    uint32_t count;
+} histogram_t;
+
+typedef struct {
+    const char * name;
+    esp_err_t (*handler)(httpd_req_t *r);
+    uint32_t requests;
+    uint32_t errors;
+    int64_t time;                         // total time in the handler (us)
+} handler_metrics_t;
+
+static portMUX_TYPE metricsMux = portMUX_INITIALIZER_UNLOCKED;
+
+// Latencies are recorded in microseconds and reported in seconds
+static histogram_t fbGetTime = { "esp32cam_fb_get_seconds", "Time taken by esp_camera_fb_get()", 1000000,
+    { 5000, 10000, 20000, 50000, 100000, 200000, 500000, 0 } };
+static histogram_t sendTime = { "esp32cam_frame_send_seconds", "Time taken to send one frame to a stream client", 1000000,
+    { 1000, 5000, 10000, 50000, 100000, 500000, 1000000, 0 } };
+static histogram_t frameSize = { "esp32cam_jpeg_bytes", "Size of captured JPEG frames", 1,
+    { 10000, 20000, 50000, 100000, 200000, 500000, 0 } };
+
+static uint32_t framesSent = 0;
+static uint32_t framesDropped = 0;
+static uint64_t bytesSent = 0;
+static uint32_t sensorWrites = 0;
+static uint32_t sensorWritesAvoided = 0;
+static int64_t sensorWriteTime = 0;       // total time in sensor setters (us)
+
+static handler_metrics_t handlers[METRICS_HANDLERS];
+static int handlerCount = 0;
+
+static void observe(histogram_t * h, uint32_t value) {
+    int i = 0;
+    while ((i < METRICS_BUCKETS) && h->bounds[i] && (value > h->bounds[i])) i++;
+    if ((i < METRICS_BUCKETS) && !h->bounds[i]) i = METRICS_BUCKETS;
+    h->counts[i]++;
+    h->sum += value;
+    h->count++;
+}
+
+void metricsFbGet(int64_t time, size_t len) {
+    portENTER_CRITICAL(&metricsMux);
+    observe(&fbGetTime, (uint32_t)time);
+    if (len) observe(&frameSize, len);
+    portEXIT_CRITICAL(&metricsMux);
+}
+
+void metricsFrameSent(size_t len, int64_t time) {
+    portENTER_CRITICAL(&metricsMux);
+    observe(&sendTime, (uint32_t)time);
+    framesSent++;
+    bytesSent += len;
+    portEXIT_CRITICAL(&metricsMux);
+}
+
+void metricsFramesDropped(uint32_t count) {
+    portENTER_CRITICAL(&metricsMux);
+    framesDropped += count;
+    portEXIT_CRITICAL(&metricsMux);
+}
+
+// A setting was written to the sensor, taking 'time' us, or skipped because the sensor already had it
+void metricsSensorWrite(int64_t time, bool written) {
+    portENTER_CRITICAL(&metricsMux);
+    if (written) {
+        sensorWrites++;
+        sensorWriteTime += time;
+    } else {
+        sensorWritesAvoided++;
+    }
+    portEXIT_CRITICAL(&metricsMux);
+}
+
+static esp_err_t metrics_wrapper(httpd_req_t *req) {
+    handler_metrics_t * m = (handler_metrics_t *)req->user_ctx;
+    int64_t start = esp_timer_get_time();
+    esp_err_t res = m->handler(req);
+    int64_t time = esp_timer_get_time() - start;
+    portENTER_CRITICAL(&metricsMux);
+    m->requests++;
+    if (res != ESP_OK) m->errors++;
+    m->time += time;
+    portEXIT_CRITICAL(&metricsMux);
+    return res;
+}
+
+// Count and time requests to 'uri'; call before registering it. URIs served
+// by the same handler under the same name share one set of counters.
+void metricsWrap(httpd_uri_t * uri, const char * name) {
+    if (uri->handler == metrics_wrapper) return;
+    handler_metrics_t * m = NULL;
+    for (int i = 0; i < handlerCount; i++) {
+        if (!strcmp(handlers[i].name, name) && (handlers[i].handler == uri->handler)) m = &handlers[i];
+    }
+    if (!m) {
+        if (handlerCount == METRICS_HANDLERS) return;
+        m = &handlers[handlerCount++];
+        m->name = name;
+        m->handler = uri->handler;
+    }
+    uri->handler = metrics_wrapper;
+    uri->user_ctx = m;
+}
+
+// Output buffer that is sent as a chunk whenever it fills up; each scrape allocates its own
+typedef struct {
+    httpd_req_t * req;
+    char * buf;
+    char * p;
+    esp_err_t res;
+} metrics_out_t;
+
+static void flush(metrics_out_t * out) {
+    if ((out->p > out->buf) && (out->res == ESP_OK)) {
+        out->res = httpd_resp_send_chunk(out->req, out->buf, out->p - out->buf);
+    }
+    out->p = out->buf;
+}
+
+// Make room for one more line
+static void room(metrics_out_t * out) {
+    if (out->p - out->buf > METRICS_CHUNK) flush(out);
+}
+
+static void put_metric(metrics_out_t * out, const char * name, const char * type, const char * help) {
+    room(out);
+    out->p+=sprintf(out->p, "# HELP %s %s\n# TYPE %s %s\n", name, help, name, type);
+}
+
+static void put_value(metrics_out_t * out, const char * name, const char * type, const char * help, double value) {
+    put_metric(out, name, type, help);
+    room(out);
+    out->p+=sprintf(out->p, "%s %.0f\n", name, value);
+}
+
+static void put_histogram(metrics_out_t * out, const histogram_t * h) {
+    put_metric(out, h->name, "histogram", h->help);
+    uint32_t cumulative = 0;
+    for (int i = 0; (i < METRICS_BUCKETS) && h->bounds[i]; i++) {
+        cumulative += h->counts[i];
+        room(out);
+        out->p+=sprintf(out->p, "%s_bucket{le=\"%g\"} %u\n", h->name, h->bounds[i] / h->scale, cumulative);
+    }
+    room(out);
+    out->p+=sprintf(out->p, "%s_bucket{le=\"+Inf\"} %u\n", h->name, h->count);
+    room(out);
+    out->p+=sprintf(out->p, "%s_sum %g\n", h->name, h->sum / h->scale);
+    room(out);
+    out->p+=sprintf(out->p, "%s_count %u\n", h->name, h->count);
+}
+
+esp_err_t metricsWrite(httpd_req_t *req) {
+    metrics_out_t out;
+    out.req = req;
+    out.buf = (char*)malloc(METRICS_CHUNK + METRICS_LINE);
+    if (!out.buf) return httpd_resp_send_500(req);
+    out.p = out.buf;
+    out.res = ESP_OK;
+
+    // Take a consistent copy of everything the hot paths update
+    portENTER_CRITICAL(&metricsMux);
+    histogram_t fbGet = fbGetTime;
+    histogram_t send = sendTime;
+    histogram_t size = frameSize;
+    uint32_t sent = framesSent;
+    uint32_t dropped = framesDropped;
+    uint64_t bytes = bytesSent;
+    uint32_t writes = sensorWrites;
+    uint32_t writesAvoided = sensorWritesAvoided;
+    int64_t writeTime = sensorWriteTime;
+    handler_metrics_t snapshot[METRICS_HANDLERS];
+    int nHandlers = handlerCount;
+    memcpy(snapshot, handlers, sizeof(handler_metrics_t) * nHandlers);
+    portEXIT_CRITICAL(&metricsMux);
+
+    put_value(&out, "esp32cam_frames_captured_total", "counter", "Frames captured into the frame ring", frameRingSeq());
+    put_metric(&out, "esp32cam_frames_dropped_total", "counter", "Frames dropped, by where they were dropped");
+    room(&out);
+    out.p+=sprintf(out.p, "esp32cam_frames_dropped_total{stage=\"ring\"} %u\n", frameRingDropped());
+    room(&out);
+    out.p+=sprintf(out.p, "esp32cam_frames_dropped_total{stage=\"client\"} %u\n", dropped);
+    put_value(&out, "esp32cam_frames_sent_total", "counter", "Frames sent to stream clients", sent);
+    put_value(&out, "esp32cam_bytes_sent_total", "counter", "JPEG bytes sent to stream clients", bytes);
+    put_value(&out, "esp32cam_streams_active", "gauge", "Connected stream clients", streamCount);
+    put_value(&out, "esp32cam_streams_served_total", "counter", "Completed streams", streamsServed);
+    put_value(&out, "esp32cam_images_served_total", "counter", "Still images served", imagesServed);
+    put_value(&out, "esp32cam_sensor_writes_total", "counter", "Settings written to the sensor", writes);
+    put_value(&out, "esp32cam_sensor_writes_avoided_total", "counter", "Sensor writes skipped because the sensor already had the value", writesAvoided);
+    put_metric(&out, "esp32cam_sensor_write_seconds_total", "counter", "Time spent writing settings to the sensor");
+    room(&out);
+    out.p+=sprintf(out.p, "esp32cam_sensor_write_seconds_total %g\n", writeTime / 1000000.0);
+    put_histogram(&out, &fbGet);
+    put_histogram(&out, &send);
+    put_histogram(&out, &size);
+
+    put_metric(&out, "esp32cam_http_requests_total", "counter", "HTTP requests, by handler");
+    for (int i = 0; i < nHandlers; i++) {
+        room(&out);
+        out.p+=sprintf(out.p, "esp32cam_http_requests_total{handler=\"%s\"} %u\n", snapshot[i].name, snapshot[i].requests);
+    }
+    put_metric(&out, "esp32cam_http_request_errors_total", "counter", "HTTP requests whose handler failed, by handler");
+    for (int i = 0; i < nHandlers; i++) {
+        room(&out);
+        out.p+=sprintf(out.p, "esp32cam_http_request_errors_total{handler=\"%s\"} %u\n", snapshot[i].name, snapshot[i].errors);
+    }
+    put_metric(&out, "esp32cam_http_request_seconds_total", "counter", "Time spent in HTTP handlers, by handler");
+    for (int i = 0; i < nHandlers; i++) {
+        room(&out);
+        out.p+=sprintf(out.p, "esp32cam_http_request_seconds_total{handler=\"%s\"} %g\n", snapshot[i].name, snapshot[i].time / 1000000.0);
+    }
+
+    put_value(&out, "esp32cam_heap_free_bytes", "gauge", "Free internal heap", ESP.getFreeHeap());
+    put_value(&out, "esp32cam_heap_min_free_bytes", "gauge", "Lowest free internal heap since boot", ESP.getMinFreeHeap());
+    put_value(&out, "esp32cam_heap_max_block_bytes", "gauge", "Largest allocatable internal heap block", ESP.getMaxAllocHeap());
+    put_value(&out, "esp32cam_psram_free_bytes", "gauge", "Free PSRAM", ESP.getFreePsram());
+    put_value(&out, "esp32cam_psram_max_block_bytes", "gauge", "Largest allocatable PSRAM block", ESP.getMaxAllocPsram());
+    if (!accesspoint) {
+        put_value(&out, "esp32cam_wifi_rssi_dbm", "gauge", "Wi-Fi signal strength", WiFi.RSSI());
+    }
+    put_value(&out, "esp32cam_uptime_seconds", "gauge", "Time since boot", esp_timer_get_time() / 1000000);
+
+    flush(&out);
+    free(out.buf);
+    if (out.res != ESP_OK) return out.res;
+    return httpd_resp_send_chunk(req, NULL, 0);
+}
@@ -0,0 +1,17 @@
+//
+// Counters and histograms for the /metrics endpoint (Prometheus text format).
+//
+// The record functions are cheap enough for the capture and send paths;
+// everything else is read when /metrics is scraped.
+//
+
+#pragma once
+
+#include <esp_http_server.h>
+
+extern void metricsFbGet(int64_t time, size_t len);
+extern void metricsFrameSent(size_t len, int64_t time);
+extern void metricsFramesDropped(uint32_t count);
+extern void metricsSensorWrite(int64_t time, bool written);
+extern void metricsWrap(httpd_uri_t * uri, const char * name);
+extern esp_err_t metricsWrite(httpd_req_t *req);
@@ -148,6 +148,18 @@ struct station stationList[] = {{"ssid1", "pass1", true},
 // max_fps = 1000/min_frame_time
 // #define MIN_FRAME_TIME 500
 
+// Adaptive bitrate for the stream; steps JPEG quality (and framesize when set
+// to 2) to follow the available bandwidth. 0 = off, 1 = quality, 2 = both
+// #define ABR_MODE 1
+
+// Per client stream bitrate the adaptive bitrate aims for, in kbit/s.
+// When 0 it instead keeps the frame rate up by backing off when the link saturates.
+// #define ABR_TARGET_KBPS 2000
+
+// While a stream is running /capture returns the newest stream frame, without
+// lamp or LED delays, if it is at most this many ms old. 0 = always take a new one
+// #define CAPTURE_MAX_AGE 500
+
 /*
  * Additional Features
  *
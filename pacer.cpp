@@ -0,0 +1,60 @@
+//
+// Token bucket frame pacer.
+//
+
+#include <esp_timer.h>
+#include <Arduino.h>
+
+#include "pacer.h"
+
+// The achieved frame rate is counted over windows of at least this long (us),
+// so the short gaps of a burst (such as the first frames) do not skew it
+#define PACER_FPS_WINDOW 1000000
+
+void pacerInit(pacer_t * pacer, int64_t interval, int burst) {
+    pacer->interval = interval;
+    pacer->burst = max(burst, 1);
+    pacer->credit = interval;   // the first frame can go at once
+    pacer->refilled = esp_timer_get_time();
+    pacer->windowStart = 0;
+    pacer->windowFrames = 0;
+    pacer->fps = 0;
+}
+
+void pacerSetInterval(pacer_t * pacer, int64_t interval) {
+    if (interval == pacer->interval) return;
+    pacer->interval = interval;
+    if (pacer->credit > interval * pacer->burst) pacer->credit = interval * pacer->burst;
+}
+
+// Microseconds until the next frame is allowed, 0 if it can go now
+int64_t pacerDelay(pacer_t * pacer) {
+    if (pacer->interval <= 0) return 0;
+    int64_t now = esp_timer_get_time();
+    pacer->credit += now - pacer->refilled;
+    pacer->refilled = now;
+    int64_t limit = pacer->interval * pacer->burst;
+    if (pacer->credit > limit) pacer->credit = limit;
+    return (pacer->credit >= pacer->interval) ? 0 : pacer->interval - pacer->credit;
+}
+
+// Account for a frame being sent now
+void pacerTake(pacer_t * pacer) {
+    int64_t now = esp_timer_get_time();
+    if (pacer->interval > 0) pacer->credit -= pacer->interval;
+    if (!pacer->windowStart) {
+        pacer->windowStart = now;
+        return;
+    }
+    pacer->windowFrames++;
+    if (now - pacer->windowStart >= PACER_FPS_WINDOW) {
+        pacer->fps = pacer->windowFrames * 1000000.0f / (now - pacer->windowStart);
+        pacer->windowStart = now;
+        pacer->windowFrames = 0;
+    }
+}
+
+// Target frame rate, 0 when unlimited
+float pacerTargetFps(const pacer_t * pacer) {
+    return (pacer->interval > 0) ? 1000000.0f / pacer->interval : 0;
+}
@@ -0,0 +1,31 @@
+//
+// Token bucket frame pacer.
+//
+// Allowance accrues continuously at one frame per interval, measured with
+// esp_timer, and is capped at 'burst' frames. A frame that goes out late
+// leaves no debt or drift behind, and a short stall can be caught up with
+// a brief burst instead of being lost.
+//
+
+#pragma once
+
+#include <stdint.h>
+
+// Default number of frames that may be sent back to back after a stall
+#define PACER_BURST 2
+
+typedef struct {
+    int64_t interval;     // target time between frames (us), 0 = unlimited
+    int burst;            // most frames that can be banked
+    int64_t credit;       // banked allowance (us)
+    int64_t refilled;     // when credit was last topped up
+    int64_t windowStart;  // when the frame that opened the current fps window was taken
+    uint32_t windowFrames; // frames taken since then
+    float fps;            // achieved frame rate over the last window
+} pacer_t;
+
+extern void pacerInit(pacer_t * pacer, int64_t interval, int burst);
+extern void pacerSetInterval(pacer_t * pacer, int64_t interval);
+extern int64_t pacerDelay(pacer_t * pacer);
+extern void pacerTake(pacer_t * pacer);
+extern float pacerTargetFps(const pacer_t * pacer);
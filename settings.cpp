@@ -0,0 +1,347 @@
+//
+// Camera and server settings, described once.
+//
+
+#include <esp_http_server.h>
+#include <esp_camera.h>
+#include <esp_timer.h>
+#include <Arduino.h>
+
+#include "settings.h"
+#include "abr.h"
+#include "metrics.h"
+#include "src/jsonlib/jsonlib.h"
+
+// These are defined in the main .ino file
+extern void setLamp(int newVal);
+extern void fadeLamp(int newVal);
+extern int lampVal;
+extern bool autoLamp;
+extern int8_t streamCount;
+extern unsigned long xclk;
+extern int myRotation;
+extern int minFrameTime;
+extern int abrMode;
+extern int abrTargetKbps;
+extern int captureMaxAge;
+extern int sensorPID;
+
+// Hash slots; several times the number of settings so a collision free seed is quick to find
+#define SETTINGS_HASH_SLOTS 256
+#define SETTINGS_HASH_TRIES 100000
+
+// Sensor settings that map straight onto a status field and a driver setter
+#define SENSOR_GET(field) \
+    static int get_##field(sensor_t * s) { return s->status.field; }
+#define SENSOR_SET(name, setter) \
+    static int set_##name(sensor_t * s, int value) { return s->setter(s, value); }
+
+SENSOR_GET(framesize)
+SENSOR_GET(quality)
+SENSOR_GET(brightness)
+SENSOR_GET(contrast)
+SENSOR_GET(saturation)
+SENSOR_GET(sharpness)
+SENSOR_GET(denoise)
+SENSOR_GET(special_effect)
+SENSOR_GET(wb_mode)
+SENSOR_GET(awb)
+SENSOR_GET(awb_gain)
+SENSOR_GET(aec)
+SENSOR_GET(aec2)
+SENSOR_GET(ae_level)
+SENSOR_GET(aec_value)
+SENSOR_GET(agc)
+SENSOR_GET(agc_gain)
+SENSOR_GET(gainceiling)
+SENSOR_GET(bpc)
+SENSOR_GET(wpc)
+SENSOR_GET(raw_gma)
+SENSOR_GET(lenc)
+SENSOR_GET(vflip)
+SENSOR_GET(hmirror)
+SENSOR_GET(dcw)
+SENSOR_GET(colorbar)
+
+SENSOR_SET(brightness, set_brightness)
+SENSOR_SET(contrast, set_contrast)
+SENSOR_SET(saturation, set_saturation)
+SENSOR_SET(sharpness, set_sharpness)
+SENSOR_SET(denoise, set_denoise)
+SENSOR_SET(special_effect, set_special_effect)
+SENSOR_SET(wb_mode, set_wb_mode)
+SENSOR_SET(awb, set_whitebal)
+SENSOR_SET(awb_gain, set_awb_gain)
+SENSOR_SET(aec, set_exposure_ctrl)
+SENSOR_SET(aec2, set_aec2)
+SENSOR_SET(ae_level, set_ae_level)
+SENSOR_SET(aec_value, set_aec_value)
+SENSOR_SET(agc, set_gain_ctrl)
+SENSOR_SET(agc_gain, set_agc_gain)
+SENSOR_SET(bpc, set_bpc)
+SENSOR_SET(wpc, set_wpc)
+SENSOR_SET(raw_gma, set_raw_gma)
+SENSOR_SET(lenc, set_lenc)
+SENSOR_SET(vflip, set_vflip)
+SENSOR_SET(hmirror, set_hmirror)
+SENSOR_SET(dcw, set_dcw)
+SENSOR_SET(colorbar, set_colorbar)
+
+// Settings held by the sketch rather than the sensor
+#define LOCAL_SETTING(name, variable) \
+    static int get_##name(sensor_t * s) { return variable; } \
+    static int set_##name(sensor_t * s, int value) { variable = value; return 0; }
+
+LOCAL_SETTING(min_frame_time, minFrameTime)
+LOCAL_SETTING(abr, abrMode)
+LOCAL_SETTING(abr_target_kbps, abrTargetKbps)
+LOCAL_SETTING(capture_max_age, captureMaxAge)
+LOCAL_SETTING(rotate, myRotation)
+
+static int get_lamp(sensor_t * s) { return lampVal; }
+static int get_autolamp(sensor_t * s) { return autoLamp; }
+static int get_xclk(sensor_t * s) { return xclk; }
+
+// While abr is running the sensor holds its working values; save the ones the user chose
+static int saved_framesize(sensor_t * s) { return abrBaseFramesize(s); }
+static int saved_quality(sensor_t * s) { return abrBaseQuality(s); }
+
+static int set_lamp(sensor_t * s, int value) {
+    if (lampVal == -1) return -1;
+    lampVal = value;
+    if (autoLamp) {
+       if (streamCount > 0) setLamp(lampVal);
+       else setLamp(0);
+    } else {
+        setLamp(lampVal);
+    }
+    return 0;
+}
+
+static int set_autolamp(sensor_t * s, int value) {
+    if (lampVal == -1) return -1;
+    autoLamp = value;
+    if (autoLamp) {
+       if (streamCount > 0) fadeLamp(lampVal);
+       else fadeLamp(0);
+    } else {
+        fadeLamp(lampVal);
+    }
+    return 0;
+}
+
+static int set_xclk(sensor_t * s, int value) {
+    xclk = value;
+    return s->set_xclk(s, LEDC_TIMER_0, value);
+}
+
+static int set_framesize(sensor_t * s, int value) {
+    int res = 0;
+    if (s->pixformat == PIXFORMAT_JPEG) res = s->set_framesize(s, (framesize_t)value);
+    if (!res) abrSetBase(-1, value);
+    return res;
+}
+
+static int set_quality(sensor_t * s, int value) {
+    int res = s->set_quality(s, value);
+    if (!res) abrSetBase(value, -1);
+    return res;
+}
+
+static int set_gainceiling(sensor_t * s, int value) {
+    return s->set_gainceiling(s, (gainceiling_t)value);
+}
+
+#define NONE { 1, 0 }
+#define BOTH(min, max) { { min, max }, { min, max } }
+
+// In the order they are reported, saved and restored; restoring applies them in this order too
+static const setting_t settings[] = {
+    { "lamp",            get_lamp,            NULL,            set_lamp,            BOTH(0, 100),                        SETTING_SAVED | SETTING_LAMP },
+    { "autolamp",        get_autolamp,        NULL,            set_autolamp,        BOTH(0, 1),                          SETTING_SAVED | SETTING_LAMP },
+    { "min_frame_time",  get_min_frame_time,  NULL,            set_min_frame_time,  BOTH(0, 60000),                      SETTING_SAVED },
+    { "abr",             get_abr,             NULL,            set_abr,             BOTH(ABR_OFF, ABR_FRAMESIZE),        SETTING_SAVED },
+    { "abr_target_kbps", get_abr_target_kbps, NULL,            set_abr_target_kbps, BOTH(0, 100000),                     SETTING_SAVED },
+    { "capture_max_age", get_capture_max_age, NULL,            set_capture_max_age, BOTH(0, 60000),                      SETTING_SAVED },
+    { "framesize",       get_framesize,       saved_framesize, set_framesize,       { { 0, FRAMESIZE_UXGA }, { 0, FRAMESIZE_QSXGA } }, SETTING_SAVED | SETTING_SENSOR },
+    { "quality",         get_quality,         saved_quality,   set_quality,         { { 6, 63 }, { 4, 63 } },            SETTING_SAVED | SETTING_SENSOR },
+    { "xclk",            get_xclk,            NULL,            set_xclk,            BOTH(2, 32),                         SETTING_SAVED },
+    { "brightness",      get_brightness,      NULL,            set_brightness,      { { -2, 2 }, { -3, 3 } },            SETTING_SAVED | SETTING_SENSOR },
+    { "contrast",        get_contrast,        NULL,            set_contrast,        { { -2, 2 }, { -3, 3 } },            SETTING_SAVED | SETTING_SENSOR },
+    { "saturation",      get_saturation,      NULL,            set_saturation,      { { -2, 2 }, { -4, 4 } },            SETTING_SAVED | SETTING_SENSOR },
+    { "sharpness",       get_sharpness,       NULL,            set_sharpness,       { NONE, { -3, 3 } },                 SETTING_SAVED | SETTING_SENSOR },
+    { "denoise",         get_denoise,         NULL,            set_denoise,         { NONE, { 0, 8 } },                  SETTING_SAVED | SETTING_SENSOR },
+    { "special_effect",  get_special_effect,  NULL,            set_special_effect,  BOTH(0, 6),                          SETTING_SAVED | SETTING_SENSOR },
+    { "wb_mode",         get_wb_mode,         NULL,            set_wb_mode,         BOTH(0, 4),                          SETTING_SAVED | SETTING_SENSOR },
+    { "awb",             get_awb,             NULL,            set_awb,             BOTH(0, 1),                          SETTING_SAVED | SETTING_SENSOR },
+    { "awb_gain",        get_awb_gain,        NULL,            set_awb_gain,        BOTH(0, 1),                          SETTING_SAVED | SETTING_SENSOR },
+    { "aec",             get_aec,             NULL,            set_aec,             BOTH(0, 1),                          SETTING_SAVED | SETTING_SENSOR },
+    { "aec2",            get_aec2,            NULL,            set_aec2,            BOTH(0, 1),                          SETTING_SAVED | SETTING_SENSOR },
+    { "ae_level",        get_ae_level,        NULL,            set_ae_level,        { { -2, 2 }, { -5, 5 } },            SETTING_SAVED | SETTING_SENSOR },
+    { "aec_value",       get_aec_value,       NULL,            set_aec_value,       { { 0, 1200 }, { 0, 1536 } },        SETTING_SAVED | SETTING_SENSOR },
+    { "agc",             get_agc,             NULL,            set_agc,             BOTH(0, 1),                          SETTING_SAVED | SETTING_SENSOR },
+    { "agc_gain",        get_agc_gain,        NULL,            set_agc_gain,        { { 0, 30 }, { 0, 64 } },            SETTING_SAVED | SETTING_SENSOR },
+    { "gainceiling",     get_gainceiling,     NULL,            set_gainceiling,     { { 0, 6 }, { 0, 511 } },            SETTING_SAVED | SETTING_SENSOR },
+    { "bpc",             get_bpc,             NULL,            set_bpc,             BOTH(0, 1),                          SETTING_SAVED | SETTING_SENSOR },
+    { "wpc",             get_wpc,             NULL,            set_wpc,             BOTH(0, 1),                          SETTING_SAVED | SETTING_SENSOR },
+    { "raw_gma",         get_raw_gma,         NULL,            set_raw_gma,         BOTH(0, 1),                          SETTING_SAVED | SETTING_SENSOR },
+    { "lenc",            get_lenc,            NULL,            set_lenc,            BOTH(0, 1),                          SETTING_SAVED | SETTING_SENSOR },
+    { "vflip",           get_vflip,           NULL,            set_vflip,           BOTH(0, 1),                          SETTING_SAVED | SETTING_SENSOR },
+    { "hmirror",         get_hmirror,         NULL,            set_hmirror,         BOTH(0, 1),                          SETTING_SAVED | SETTING_SENSOR },
+    { "dcw",             get_dcw,             NULL,            set_dcw,             BOTH(0, 1),                          SETTING_SAVED | SETTING_SENSOR },
+    { "colorbar",        get_colorbar,        NULL,            set_colorbar,        BOTH(0, 1),                          SETTING_SAVED | SETTING_SENSOR },
+    { "rotate",          get_rotate,          NULL,            set_rotate,          BOTH(-90, 90),                       SETTING_SAVED | SETTING_QUOTED },
+};
+
+#define SETTINGS_COUNT (sizeof(settings) / sizeof(settings[0]))
+
+static_assert(SETTINGS_COUNT < SETTINGS_HASH_SLOTS, "too many settings for the hash table");
+
+// Slot -> index into settings[] + 1, 0 = empty
+static uint8_t slots[SETTINGS_HASH_SLOTS];
+static uint32_t hashSeed = 0;
+static bool hashed = false;
+
+// FNV-1a, starting from a seed so a collision free one can be chosen
+static uint32_t hash_name(const char * name, uint32_t seed) {
+    uint32_t h = 2166136261u ^ seed;
+    while (*name) {
+        h ^= (uint8_t)*name++;
+        h *= 16777619u;
+    }
+    return h % SETTINGS_HASH_SLOTS;
+}
+
+// Search for a seed that gives every setting its own slot
+void settingsInit() {
+    if (hashed) return;
+    for (uint32_t seed = 0; seed < SETTINGS_HASH_TRIES; seed++) {
+        memset(slots, 0, sizeof(slots));
+        size_t i;
+        for (i = 0; i < SETTINGS_COUNT; i++) {
+            uint32_t slot = hash_name(settings[i].name, seed);
+            if (slots[slot]) break;
+            slots[slot] = i + 1;
+        }
+        if (i == SETTINGS_COUNT) {
+            hashSeed = seed;
+            hashed = true;
+            return;
+        }
+    }
+    Serial.println("SETTINGS: no perfect hash found; falling back to a linear search");
+}
+
+const setting_t * settingFind(const char * name) {
+    if (!hashed) {
+        for (size_t i = 0; i < SETTINGS_COUNT; i++) {
+            if (!strcmp(settings[i].name, name)) return &settings[i];
+        }
+        return NULL;
+    }
+    uint8_t index = slots[hash_name(name, hashSeed)];
+    if (index && !strcmp(settings[index - 1].name, name)) return &settings[index - 1];
+    return NULL;
+}
+
+static const setting_range_t * setting_range(const setting_t * setting) {
+    bool ov3660 = (sensorPID == OV3660_PID) || (sensorPID == OV5640_PID);
+    return &setting->range[ov3660 ? SETTING_RANGE_OV3660 : SETTING_RANGE_OV2640];
+}
+
+bool settingSupported(const setting_t * setting) {
+    if ((setting->flags & SETTING_LAMP) && (lampVal == -1)) return false;
+    const setting_range_t * range = setting_range(setting);
+    return range->max >= range->min;
+}
+
+bool settingValid(const setting_t * setting, int value) {
+    const setting_range_t * range = setting_range(setting);
+    return settingSupported(setting) && (value >= range->min) && (value <= range->max);
+}
+
+// The driver's copy of the sensor state serves as a shadow of its registers; true if
+// writing 'value' would not change anything. Abr keeps the user's framesize and quality
+// apart from the sensor's, so both must match.
+bool settingCurrent(const setting_t * setting, int value) {
+    if (!(setting->flags & SETTING_SENSOR)) return false;
+    sensor_t * s = esp_camera_sensor_get();
+    if (!s) return false;
+    return (setting->get(s) == value) && (!setting->saved || (setting->saved(s) == value));
+}
+
+// Check 'value' against the sensor's range and apply it; returns 0 on success.
+// A sensor register that already holds 'value' is not written again.
+int settingSet(const setting_t * setting, int value) {
+    if (!settingValid(setting, value)) return -1;
+    sensor_t * s = esp_camera_sensor_get();
+    if (!s) return -1;
+    if (!(setting->flags & SETTING_SENSOR)) return setting->set(s, value);
+    if (settingCurrent(setting, value)) {
+        metricsSensorWrite(0, false);
+        return 0;
+    }
+    int64_t start = esp_timer_get_time();
+    int res = setting->set(s, value);
+    metricsSensorWrite(esp_timer_get_time() - start, true);
+    return res;
+}
+
+// Append every setting, or with 'saved' just those kept in the preferences, to a JSON object under construction
+char * settingsJson(char * p, bool saved) {
+    sensor_t * s = esp_camera_sensor_get();
+    for (size_t i = 0; i < SETTINGS_COUNT; i++) {
+        const setting_t * setting = &settings[i];
+        if (saved && !(setting->flags & SETTING_SAVED)) continue;
+        int value = (saved && setting->saved) ? setting->saved(s) : setting->get(s);
+        if (setting->flags & SETTING_QUOTED) p+=sprintf(p, "\"%s\":\"%d\",", setting->name, value);
+        else p+=sprintf(p, "\"%s\":%d,", setting->name, value);
+    }
+    return p;
+}
+
+// The /status settings as CBOR map entries; quoted values are plain integers here
+void settingsCbor(cbor_writer_t * w) {
+    sensor_t * s = esp_camera_sensor_get();
+    for (size_t i = 0; i < SETTINGS_COUNT; i++) {
+        cborText(w, settings[i].name);
+        cborInt(w, settings[i].get(s));
+    }
+}
+
+// Apply the saved settings found in a preferences file; missing or out of range ones are left alone.
+// Those the sensor already has are skipped, so a camera at its defaults sees few register writes.
+void settingsLoad(const String & prefs) {
+    for (size_t i = 0; i < SETTINGS_COUNT; i++) {
+        const setting_t * setting = &settings[i];
+        if (!(setting->flags & SETTING_SAVED) || !settingSupported(setting)) continue;
+        String value = jsonExtract(prefs, setting->name);
+        if (value.length() == 0) continue;
+        if (settingSet(setting, value.toInt()) != 0) {
+            Serial.printf("Preference %s=%s not applied\r\n", setting->name, value.c_str());
+        }
+    }
+}
+
+// List the settings this camera supports, with their ranges, as JSON
+esp_err_t settingsCapabilities(httpd_req_t * req) {
+    char buf[1024];
+    char * p = buf;
+    p+=sprintf(p, "{\"sensor_pid\":%d,\"settings\":[", sensorPID);
+    bool first = true;
+    for (size_t i = 0; i < SETTINGS_COUNT; i++) {
+        const setting_t * setting = &settings[i];
+        if (!settingSupported(setting)) continue;
+        const setting_range_t * range = setting_range(setting);
+        p+=sprintf(p, "%s{\"name\":\"%s\",\"min\":%d,\"max\":%d,\"saved\":%d}", first ? "" : ",",
+                   setting->name, range->min, range->max, (setting->flags & SETTING_SAVED) ? 1 : 0);
+        first = false;
+        if (p - buf > (int)sizeof(buf) - 128) {
+            if (httpd_resp_send_chunk(req, buf, p - buf) != ESP_OK) return ESP_FAIL;
+            p = buf;
+        }
+    }
+    p+=sprintf(p, "]}");
+    if (httpd_resp_send_chunk(req, buf, p - buf) != ESP_OK) return ESP_FAIL;
+    return httpd_resp_send_chunk(req, NULL, 0);
+}
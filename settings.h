@@ -0,0 +1,55 @@
+//
+// Camera and server settings, described once.
+//
+// Every setting that /control can change has one entry in a table giving its
+// name, how to read and apply it, its valid range on each sensor family and
+// whether it is saved with the preferences. /control, /status, the saved
+// preferences and /capabilities are all generated from that table, so a new
+// setting needs just one new entry.
+//
+// Names are looked up through a perfect hash that is built once at startup.
+//
+
+#pragma once
+
+#include <esp_http_server.h>
+#include <esp_camera.h>
+#include <Arduino.h>
+
+#include "src/cbor.h"
+
+// Setting flags
+#define SETTING_SAVED   0x01    // kept in the preferences file
+#define SETTING_QUOTED  0x02    // written as a string in JSON, for compatibility
+#define SETTING_LAMP    0x04    // only exists when there is a lamp
+#define SETTING_SENSOR  0x08    // written to the sensor over SCCB; unchanged values are not rewritten
+
+// Ranges are kept for two sensor families
+#define SETTING_RANGE_OV2640 0  // also used for sensors not listed below
+#define SETTING_RANGE_OV3660 1  // OV3660 and OV5640
+#define SETTING_RANGES 2
+
+typedef struct {
+    int32_t min;
+    int32_t max;                // max < min: not supported on this sensor
+} setting_range_t;
+
+typedef struct {
+    const char * name;
+    int (*get)(sensor_t * s);               // value reported by /status
+    int (*saved)(sensor_t * s);             // value to save, if not the same as get()
+    int (*set)(sensor_t * s, int value);    // apply a value; returns 0 on success
+    setting_range_t range[SETTING_RANGES];
+    uint8_t flags;
+} setting_t;
+
+extern void settingsInit();
+extern const setting_t * settingFind(const char * name);
+extern bool settingSupported(const setting_t * setting);
+extern bool settingValid(const setting_t * setting, int value);
+extern bool settingCurrent(const setting_t * setting, int value);
+extern int settingSet(const setting_t * setting, int value);
+extern char * settingsJson(char * p, bool saved);
+extern void settingsCbor(cbor_writer_t * w);
+extern void settingsLoad(const String & prefs);
+extern esp_err_t settingsCapabilities(httpd_req_t * req);
@@ -0,0 +1,187 @@
+//
+// Minimal CBOR (RFC 8949) writer and reader; see cbor.h
+//
+
+#include <math.h>
+#include <string.h>
+
+#include "cbor.h"
+
+#define MAJOR_UINT   0
+#define MAJOR_NINT   1
+#define MAJOR_BYTES  2
+#define MAJOR_TEXT   3
+#define MAJOR_ARRAY  4
+#define MAJOR_MAP    5
+#define MAJOR_TAG    6
+#define MAJOR_SIMPLE 7
+
+static void put(cbor_writer_t * w, const void * data, size_t len) {
+    if (w->len + len > w->size) {
+        w->overflow = true;
+        return;
+    }
+    memcpy(w->buf + w->len, data, len);
+    w->len += len;
+}
+
+// The initial byte and argument, in the shortest form that holds it
+static void put_head(cbor_writer_t * w, uint8_t major, uint64_t arg) {
+    uint8_t head[9];
+    size_t len;
+    if (arg < 24) {
+        head[0] = (major << 5) | arg;
+        len = 1;
+    } else {
+        int bytes = (arg <= 0xff) ? 1 : (arg <= 0xffff) ? 2 : (arg <= 0xffffffff) ? 4 : 8;
+        head[0] = (major << 5) | ((bytes == 1) ? 24 : (bytes == 2) ? 25 : (bytes == 4) ? 26 : 27);
+        for (int i = 0; i < bytes; i++) head[bytes - i] = arg >> (8 * i);
+        len = bytes + 1;
+    }
+    put(w, head, len);
+}
+
+void cborWriterInit(cbor_writer_t * w, uint8_t * buf, size_t size) {
+    w->buf = buf;
+    w->size = size;
+    w->len = 0;
+    w->overflow = false;
+}
+
+void cborMapStart(cbor_writer_t * w) {
+    uint8_t b = (MAJOR_MAP << 5) | 31;
+    put(w, &b, 1);
+}
+
+void cborMapEnd(cbor_writer_t * w) {
+    uint8_t b = 0xff;
+    put(w, &b, 1);
+}
+
+void cborInt(cbor_writer_t * w, int64_t value) {
+    if (value >= 0) put_head(w, MAJOR_UINT, value);
+    else put_head(w, MAJOR_NINT, -1 - value);
+}
+
+void cborFloat(cbor_writer_t * w, float value) {
+    uint32_t bits;
+    memcpy(&bits, &value, 4);
+    uint8_t b[5] = { 0xfa, (uint8_t)(bits >> 24), (uint8_t)(bits >> 16), (uint8_t)(bits >> 8), (uint8_t)bits };
+    put(w, b, 5);
+}
+
+void cborBool(cbor_writer_t * w, bool value) {
+    uint8_t b = value ? 0xf5 : 0xf4;
+    put(w, &b, 1);
+}
+
+void cborText(cbor_writer_t * w, const char * text) {
+    cborTextLen(w, text, strlen(text));
+}
+
+void cborTextLen(cbor_writer_t * w, const char * text, size_t len) {
+    put_head(w, MAJOR_TEXT, len);
+    put(w, text, len);
+}
+
+void cborReaderInit(cbor_reader_t * r, const uint8_t * buf, size_t len) {
+    r->p = buf;
+    r->end = buf + len;
+}
+
+static bool get_arg(cbor_reader_t * r, uint8_t info, uint64_t * arg) {
+    if (info < 24) {
+        *arg = info;
+        return true;
+    }
+    if (info > 27) return false;
+    int bytes = 1 << (info - 24);
+    if (r->end - r->p < bytes) return false;
+    *arg = 0;
+    for (int i = 0; i < bytes; i++) *arg = (*arg << 8) | *r->p++;
+    return true;
+}
+
+static double half_to_double(uint16_t half) {
+    int exp = (half >> 10) & 0x1f;
+    int mant = half & 0x3ff;
+    double value;
+    if (exp == 0) value = ldexp(mant, -24);
+    else if (exp != 31) value = ldexp(mant + 1024, exp - 25);
+    else value = mant ? NAN : INFINITY;
+    return (half & 0x8000) ? -value : value;
+}
+
+// Read the next item; strings are returned in place. False at the end of the input or if it is not valid CBOR.
+bool cborRead(cbor_reader_t * r, cbor_item_t * item) {
+    if (r->p >= r->end) return false;
+    uint8_t major = *r->p >> 5;
+    uint8_t info = *r->p++ & 0x1f;
+    uint64_t arg = 0;
+
+    if (info == 31) {
+        // Indefinite length; only arrays and maps are supported, not chunked strings
+        if ((major == MAJOR_ARRAY) || (major == MAJOR_MAP)) {
+            item->type = (major == MAJOR_ARRAY) ? CBOR_ARRAY : CBOR_MAP;
+            item->len = CBOR_INDEFINITE;
+            return true;
+        }
+        if (major == MAJOR_SIMPLE) {
+            item->type = CBOR_BREAK;
+            return true;
+        }
+        return false;
+    }
+    if (!get_arg(r, info, &arg)) return false;
+
+    switch (major) {
+        case MAJOR_UINT:
+        case MAJOR_NINT:
+            if (arg > INT64_MAX) return false;
+            item->type = CBOR_INT;
+            item->i = (major == MAJOR_UINT) ? (int64_t)arg : -1 - (int64_t)arg;
+            return true;
+        case MAJOR_BYTES:
+        case MAJOR_TEXT:
+            if (arg > (uint64_t)(r->end - r->p)) return false;
+            item->type = (major == MAJOR_BYTES) ? CBOR_BYTES : CBOR_TEXT;
+            item->data = (const char *)r->p;
+            item->len = arg;
+            r->p += arg;
+            return true;
+        case MAJOR_ARRAY:
+        case MAJOR_MAP:
+            item->type = (major == MAJOR_ARRAY) ? CBOR_ARRAY : CBOR_MAP;
+            item->len = arg;
+            return true;
+        case MAJOR_TAG:
+            item->type = CBOR_TAG;
+            item->i = arg;
+            return true;
+        default:
+            break;
+    }
+
+    // Simple values and floats
+    if (info == 25) {
+        item->type = CBOR_FLOAT;
+        item->f = half_to_double(arg);
+    } else if (info == 26) {
+        uint32_t bits = arg;
+        float f;
+        memcpy(&f, &bits, 4);
+        item->type = CBOR_FLOAT;
+        item->f = f;
+    } else if (info == 27) {
+        memcpy(&item->f, &arg, 8);
+        item->type = CBOR_FLOAT;
+    } else if ((arg == 20) || (arg == 21)) {
+        item->type = CBOR_BOOL;
+        item->i = (arg == 21);
+    } else if ((arg == 22) || (arg == 23)) {
+        item->type = CBOR_NULL;
+    } else {
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,59 @@
+//
+// Minimal CBOR (RFC 8949) writer and reader, for the binary forms of
+// /status, /info and /control.
+//
+// Only what those need is here: integers, floats, booleans, null, text and
+// maps, plus enough of the rest for the reader to step over it. Maps are
+// written with indefinite length, so nothing has to be counted first.
+//
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+typedef struct {
+    uint8_t * buf;
+    size_t size;
+    size_t len;
+    bool overflow;              // something did not fit; the output is incomplete
+} cbor_writer_t;
+
+extern void cborWriterInit(cbor_writer_t * w, uint8_t * buf, size_t size);
+extern void cborMapStart(cbor_writer_t * w);
+extern void cborMapEnd(cbor_writer_t * w);
+extern void cborInt(cbor_writer_t * w, int64_t value);
+extern void cborFloat(cbor_writer_t * w, float value);
+extern void cborBool(cbor_writer_t * w, bool value);
+extern void cborText(cbor_writer_t * w, const char * text);
+extern void cborTextLen(cbor_writer_t * w, const char * text, size_t len);
+
+// What cborRead() found
+#define CBOR_INT     0
+#define CBOR_BYTES   1
+#define CBOR_TEXT    2
+#define CBOR_ARRAY   3
+#define CBOR_MAP     4
+#define CBOR_TAG     5
+#define CBOR_BOOL    6
+#define CBOR_NULL    7
+#define CBOR_FLOAT   8
+#define CBOR_BREAK   9          // end of an indefinite length array or map
+
+#define CBOR_INDEFINITE SIZE_MAX
+
+typedef struct {
+    uint8_t type;
+    int64_t i;                  // CBOR_INT, CBOR_BOOL, CBOR_TAG
+    double f;                   // CBOR_FLOAT
+    const char * data;          // CBOR_BYTES, CBOR_TEXT; not NUL terminated
+    size_t len;                 // CBOR_BYTES, CBOR_TEXT, or items in CBOR_ARRAY, pairs in CBOR_MAP
+} cbor_item_t;
+
+typedef struct {
+    const uint8_t * p;
+    const uint8_t * end;
+} cbor_reader_t;
+
+extern void cborReaderInit(cbor_reader_t * r, const uint8_t * buf, size_t len);
+extern bool cborRead(cbor_reader_t * r, cbor_item_t * item);
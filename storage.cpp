@@ -1,14 +1,10 @@
 #include "esp_camera.h"
 #include "src/jsonlib/jsonlib.h"
 #include "storage.h"
+#include "settings.h"
 
 // These are defined in the main .ino file
 extern void flashLED(int flashtime);
-extern int myRotation;    // Rotation
-extern int lampVal;       // The current Lamp value
-extern bool autoLamp;     // Automatic lamp mode
-extern int xclk;          // Camera module clock speed
-extern int minFrameTime;  // Limits framerate
 
 /*
  * Useful utility when debugging...
@@ -87,46 +83,8 @@ void loadPrefs(fs::FS &fs){
           return;
         }
     }
-    // get sensor reference
-    sensor_t * s = esp_camera_sensor_get();
-
-    // process local settings
-    if (lampVal >= 0) {
-        int lampValPref = jsonExtract(prefs, "lamp").toInt();
-        if (lampValPref >= 0) lampVal = lampValPref;
-    }
-    minFrameTime = jsonExtract(prefs, "min_frame_time").toInt();
-    if (jsonExtract(prefs, "autolamp").toInt() == 0) autoLamp = false; else autoLamp = true;
-    int xclkPref = jsonExtract(prefs, "xclk").toInt();
-    if (xclkPref >= 2) xclk = xclkPref;
-    myRotation = jsonExtract(prefs, "rotate").toInt();
-
-    // process camera settings
-    s->set_framesize(s, (framesize_t)jsonExtract(prefs, "framesize").toInt());
-    s->set_quality(s, jsonExtract(prefs, "quality").toInt());
-    s->set_xclk(s, LEDC_TIMER_0, xclk);
-    s->set_brightness(s, jsonExtract(prefs, "brightness").toInt());
-    s->set_contrast(s, jsonExtract(prefs, "contrast").toInt());
-    s->set_saturation(s, jsonExtract(prefs, "saturation").toInt());
-    s->set_special_effect(s, jsonExtract(prefs, "special_effect").toInt());
-    s->set_wb_mode(s, jsonExtract(prefs, "wb_mode").toInt());
-    s->set_whitebal(s, jsonExtract(prefs, "awb").toInt());
-    s->set_awb_gain(s, jsonExtract(prefs, "awb_gain").toInt());
-    s->set_exposure_ctrl(s, jsonExtract(prefs, "aec").toInt());
-    s->set_aec2(s, jsonExtract(prefs, "aec2").toInt());
-    s->set_ae_level(s, jsonExtract(prefs, "ae_level").toInt());
-    s->set_aec_value(s, jsonExtract(prefs, "aec_value").toInt());
-    s->set_gain_ctrl(s, jsonExtract(prefs, "agc").toInt());
-    s->set_agc_gain(s, jsonExtract(prefs, "agc_gain").toInt());
-    s->set_gainceiling(s, (gainceiling_t)jsonExtract(prefs, "gainceiling").toInt());
-    s->set_bpc(s, jsonExtract(prefs, "bpc").toInt());
-    s->set_wpc(s, jsonExtract(prefs, "wpc").toInt());
-    s->set_raw_gma(s, jsonExtract(prefs, "raw_gma").toInt());
-    s->set_lenc(s, jsonExtract(prefs, "lenc").toInt());
-    s->set_vflip(s, jsonExtract(prefs, "vflip").toInt());
-    s->set_hmirror(s, jsonExtract(prefs, "hmirror").toInt());
-    s->set_dcw(s, jsonExtract(prefs, "dcw").toInt());
-    s->set_colorbar(s, jsonExtract(prefs, "colorbar").toInt());
+    // apply the saved settings
+    settingsLoad(prefs);
     // close the file
     file.close();
     dumpPrefs(SPIFFS);
@@ -143,40 +101,11 @@ void savePrefs(fs::FS &fs){
   }
   File file = fs.open(PREFERENCES_FILE, FILE_WRITE);
   static char json_response[1024];
-  sensor_t * s = esp_camera_sensor_get();
   char * p = json_response;
   *p++ = '{';
-  p+=sprintf(p, "\"lamp\":%i,", lampVal);
-  p+=sprintf(p, "\"autolamp\":%u,", autoLamp);
-  p+=sprintf(p, "\"framesize\":%u,", s->status.framesize);
-  p+=sprintf(p, "\"quality\":%u,", s->status.quality);
-  p+=sprintf(p, "\"xclk\":%u,", xclk);
-  p+=sprintf(p, "\"min_frame_time\":%d,", minFrameTime);
-  p+=sprintf(p, "\"brightness\":%d,", s->status.brightness);
-  p+=sprintf(p, "\"contrast\":%d,", s->status.contrast);
-  p+=sprintf(p, "\"saturation\":%d,", s->status.saturation);
-  p+=sprintf(p, "\"special_effect\":%u,", s->status.special_effect);
-  p+=sprintf(p, "\"wb_mode\":%u,", s->status.wb_mode);
-  p+=sprintf(p, "\"awb\":%u,", s->status.awb);
-  p+=sprintf(p, "\"awb_gain\":%u,", s->status.awb_gain);
-  p+=sprintf(p, "\"aec\":%u,", s->status.aec);
-  p+=sprintf(p, "\"aec2\":%u,", s->status.aec2);
-  p+=sprintf(p, "\"ae_level\":%d,", s->status.ae_level);
-  p+=sprintf(p, "\"aec_value\":%u,", s->status.aec_value);
-  p+=sprintf(p, "\"agc\":%u,", s->status.agc);
-  p+=sprintf(p, "\"agc_gain\":%u,", s->status.agc_gain);
-  p+=sprintf(p, "\"gainceiling\":%u,", s->status.gainceiling);
-  p+=sprintf(p, "\"bpc\":%u,", s->status.bpc);
-  p+=sprintf(p, "\"wpc\":%u,", s->status.wpc);
-  p+=sprintf(p, "\"raw_gma\":%u,", s->status.raw_gma);
-  p+=sprintf(p, "\"lenc\":%u,", s->status.lenc);
-  p+=sprintf(p, "\"vflip\":%u,", s->status.vflip);
-  p+=sprintf(p, "\"hmirror\":%u,", s->status.hmirror);
-  p+=sprintf(p, "\"dcw\":%u,", s->status.dcw);
-  p+=sprintf(p, "\"colorbar\":%u,", s->status.colorbar);
-  p+=sprintf(p, "\"rotate\":\"%d\"", myRotation);
-  *p++ = '}';
-  *p++ = 0;
+  p = settingsJson(p, true);
+  *(p - 1) = '}';
+  *p = 0;
   file.print(json_response);
   file.close();
   dumpPrefs(SPIFFS);
@@ -2,7 +2,7 @@
 #include "SPIFFS.h"
 
 #define FORMAT_SPIFFS_IF_FAILED true
-#define PREFERENCES_MAX_SIZE 500
+#define PREFERENCES_MAX_SIZE 1000
 
 #define PREFERENCES_FILE "/esp32cam-preferences.json"
 
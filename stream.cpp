@@ -0,0 +1,669 @@
+//
+// Multi-client MJPEG stream broadcaster.
+//
+// One capture task owns the camera while anybody is watching. Each frame it
+// grabs is published once into the frame ring (framering.cpp), and every
+// client has a sender task that pushes the newest frame down its own socket,
+// so N viewers cost one sensor read per frame instead of N.
+//
+// The httpd handler only sends the response headers and hands the socket
+// over to a sender task; this leaves the stream server free to accept more
+// clients while the existing ones are running.
+//
+// The same sender tasks serve WebSocket clients (/ws), which get each frame
+// as one binary message with a small header (see stream.h) and can pace
+// delivery by granting credits.
+//
+
+#include <esp_http_server.h>
+#include <esp_timer.h>
+#include <esp_camera.h>
+#include <lwip/sockets.h>
+#include <Arduino.h>
+
+#include "stream.h"
+#include "abr.h"
+#include "pacer.h"
+#include "metrics.h"
+#include "events.h"
+#include "framering.h"
+
+// Functions from the main .ino
+extern void fadeLamp(int newVal);
+
+// External variables declared in the main .ino
+extern int8_t streamCount;
+extern unsigned long streamsServed;
+extern int minFrameTime;
+extern int lampVal;
+extern bool autoLamp;
+extern bool debugData;
+
+#define PART_BOUNDARY "123456789000000000000987654321"
+static const char* _STREAM_CONTENT_TYPE = "multipart/x-mixed-replace;boundary=" PART_BOUNDARY;
+static const char* _STREAM_BOUNDARY = "\r\n--" PART_BOUNDARY "\r\n";
+
+// Each part goes out as a single chunk: size, part header, JPEG, boundary, chunk end
+static const char _PART_TYPE[] = "Content-Type: image/jpeg\r\nContent-Length: ";
+static const char _PART_TAIL[] = "\r\n--" PART_BOUNDARY "\r\n" "\r\n";
+
+// Raw mode bypasses httpd and its chunked encoding, writing the response headers directly
+static const char _RAW_HEADERS[] = "HTTP/1.1 200 OK\r\n"
+                                   "Content-Type: multipart/x-mixed-replace;boundary=" PART_BOUNDARY "\r\n"
+                                   "Access-Control-Allow-Origin: *\r\n"
+                                   "Cache-Control: no-cache\r\n"
+                                   "Connection: close\r\n"
+                                   "\r\n"
+                                   "--" PART_BOUNDARY "\r\n";
+
+// Largest WebSocket control frame payload (RFC 6455)
+#define STREAM_WS_CONTROL_MAX 125
+
+// A connected client; owned jointly by its httpd session and its sender task
+typedef struct {
+    httpd_handle_t hd;
+    int fd;
+    int refs;
+    bool closed;                  // httpd has closed the session
+    bool killed;                  // a stop was requested via /stop
+    bool raw;                     // multipart body written without chunked encoding
+    bool ws;                      // WebSocket client; frames go out as binary messages
+    bool credited;                // the WebSocket client has asked for flow control
+    int32_t credits;              // frames it will still take; only used once credited
+    uint8_t control[2 + STREAM_WS_CONTROL_MAX];  // a pong or close waiting to go out between two messages
+    size_t controlLen;
+    pacer_t pacer;                // per-client frame rate from ?fps=
+    uint32_t skip;                // frames to skip after each one sent, from ?skip=
+    SemaphoreHandle_t sendLock;   // held while writing to the socket
+    TaskHandle_t task;
+    uint32_t frames;              // frames sent
+    uint32_t dropped;             // frames passed over because the client was backed up
+    uint32_t skipped;             // frames passed over by its own pacing or ?skip=
+    size_t pending;               // bytes of the current part not yet taken by the socket
+    bool backedUp;                // the socket filled up with more than STREAM_BACKLOG_MAX of them pending
+    int64_t sendTime;             // total microseconds spent sending them
+} stream_client_t;
+
+// A client that takes no data at all for this long (ms) is disconnected
+#define STREAM_STALL_TIMEOUT 5000
+
+// How often (ms) a full socket is polled for room
+#define STREAM_POLL_MS 20
+
+static stream_client_t * clients[MAX_STREAMS];
+static SemaphoreHandle_t streamLock = NULL;   // protects clients[]
+static SemaphoreHandle_t cameraLock = NULL;   // serialises esp_camera_fb_get() callers
+static uint32_t pausing = 0;                  // streamPauseCapture() callers waiting for cameraLock; atomic
+static TaskHandle_t captureTask = NULL;
+static pacer_t capturePacer;                  // min_frame_time, for all clients at once
+
+// Grab one frame from the driver, copy it into the frame ring and give the driver buffer back
+static bool capture_frame() {
+    xSemaphoreTake(cameraLock, portMAX_DELAY);
+    int64_t start = esp_timer_get_time();
+    camera_fb_t * fb = esp_camera_fb_get();
+    metricsFbGet(esp_timer_get_time() - start, fb ? fb->len : 0);
+    bool ok = false;
+    if (!fb) {
+        Serial.println("CAMERA: failed to acquire frame");
+    } else if (fb->format != PIXFORMAT_JPEG) {
+        Serial.println("CAMERA: Non-JPEG frame returned by camera module");
+    } else {
+        ok = frameRingPublish(fb);
+    }
+    if (fb) esp_camera_fb_return(fb);
+    xSemaphoreGive(cameraLock);
+    return ok;
+}
+
+static void capture_task(void * arg) {
+    while (true) {
+        if (streamCount == 0) {
+            // Nobody is watching; sleep until a client arrives
+            abrRestore();
+            ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+            pacerInit(&capturePacer, minFrameTime * 1000LL, PACER_BURST);
+            continue;
+        }
+        // A mutex does not queue its waiters, so step aside until a pause has the camera
+        if (__atomic_load_n(&pausing, __ATOMIC_ACQUIRE)) {
+            delay(1);
+            continue;
+        }
+        // minFrameTime limits the capture rate for all clients at once
+        pacerSetInterval(&capturePacer, minFrameTime * 1000LL);
+        int64_t wait = pacerDelay(&capturePacer);
+        if (wait > 0) {
+            ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(wait / 1000) + 1);
+            continue;
+        }
+        pacerTake(&capturePacer);
+
+        if (!capture_frame()) delay(100);
+        abrUpdate();
+    }
+}
+
+// Drop a client reference, freeing it when both owners are done
+static void client_put(stream_client_t * client) {
+    xSemaphoreTake(streamLock, portMAX_DELAY);
+    bool last = (--client->refs == 0);
+    xSemaphoreGive(streamLock);
+    if (last) {
+        vSemaphoreDelete(client->sendLock);
+        free(client);
+    }
+}
+
+// Called by httpd when the client session is closed
+static void client_session_closed(void * ctx) {
+    stream_client_t * client = (stream_client_t *)ctx;
+    // Wait for any write in progress; the socket is not touched after this
+    xSemaphoreTake(client->sendLock, portMAX_DELAY);
+    client->closed = true;
+    xSemaphoreGive(client->sendLock);
+    // The sender task clears its handle under streamLock before it exits
+    xSemaphoreTake(streamLock, portMAX_DELAY);
+    if (client->task) xTaskNotifyGive(client->task);
+    xSemaphoreGive(streamLock);
+    client_put(client);
+}
+
+// Wait up to 'ms' for the socket to have room in its send buffer. This runs
+// without sendLock, so httpd is never held up closing the session; if it
+// closes meanwhile the select just fails, and nothing is written after it.
+static bool client_wait_writable(stream_client_t * client, int ms) {
+    if (client->closed) return false;
+    fd_set fds;
+    FD_ZERO(&fds);
+    FD_SET(client->fd, &fds);
+    struct timeval tv = { 0, ms * 1000 };
+    return (lwip_select(client->fd + 1, NULL, &fds, NULL, &tv) > 0);
+}
+
+// Write a scatter/gather list to the socket without blocking in lwIP. While
+// the socket is full we poll, so a closed session is noticed straight away;
+// a client that accepts nothing for STREAM_STALL_TIMEOUT is given up on.
+static bool client_writev(stream_client_t * client, struct iovec * iov, int iovcnt) {
+    size_t pending = 0;
+    for (int i = 0; i < iovcnt; i++) pending += iov[i].iov_len;
+    client->pending = pending;
+    int64_t last_progress = esp_timer_get_time();
+
+    while ((iovcnt > 0) && !client->closed) {
+        int sent = -1;
+        int err = 0;
+        xSemaphoreTake(client->sendLock, portMAX_DELAY);
+        if (!client->closed) {
+            struct msghdr msg;
+            memset(&msg, 0, sizeof(msg));
+            msg.msg_iov = iov;
+            msg.msg_iovlen = iovcnt;
+            sent = lwip_sendmsg(client->fd, &msg, MSG_DONTWAIT);
+            if (sent < 0) err = errno;
+        }
+        xSemaphoreGive(client->sendLock);
+
+        if (sent < 0) {
+            if ((err != EAGAIN) && (err != EWOULDBLOCK)) break;
+            if (pending > STREAM_BACKLOG_MAX) client->backedUp = true;
+            if (esp_timer_get_time() - last_progress > STREAM_STALL_TIMEOUT * 1000LL) {
+                Serial.printf("Stream %i stalled with %uB pending\r\n", client->fd, (uint32_t)pending);
+                break;
+            }
+            client_wait_writable(client, STREAM_POLL_MS);
+            continue;
+        }
+        last_progress = esp_timer_get_time();
+        pending -= sent;
+        client->pending = pending;
+        // Step over whatever has been written
+        while ((iovcnt > 0) && ((size_t)sent >= iov->iov_len)) {
+            sent -= iov->iov_len;
+            iov++;
+            iovcnt--;
+        }
+        if (iovcnt > 0) {
+            iov->iov_base = (char *)iov->iov_base + sent;
+            iov->iov_len -= sent;
+        }
+    }
+    return (iovcnt == 0);
+}
+
+static bool client_send(stream_client_t * client, const char * buf, size_t len) {
+    struct iovec iov = { (void *)buf, len };
+    return client_writev(client, &iov, 1);
+}
+
+static uint8_t * put_le(uint8_t * p, uint64_t v, int bytes) {
+    while (bytes--) {
+        *p++ = v & 0xff;
+        v >>= 8;
+    }
+    return p;
+}
+
+// Integer formatters for the part header; much cheaper than snprintf per frame
+static char * put_dec(char * p, uint32_t v) {
+    char tmp[10];
+    int n = 0;
+    do {
+        tmp[n++] = '0' + (v % 10);
+        v /= 10;
+    } while (v);
+    while (n) *p++ = tmp[--n];
+    return p;
+}
+
+static char * put_hex(char * p, uint32_t v) {
+    static const char digits[] = "0123456789abcdef";
+    char tmp[8];
+    int n = 0;
+    do {
+        tmp[n++] = digits[v & 0xf];
+        v >>= 4;
+    } while (v);
+    while (n) *p++ = tmp[--n];
+    return p;
+}
+
+// Send one multipart part (header, JPEG and boundary) in one write; unless
+// the client is in raw mode the whole part is wrapped in a single chunk
+static bool client_send_part(stream_client_t * client, const frame_t * frame) {
+    char len_str[10];
+    size_t len_len = put_dec(len_str, frame->len) - len_str;
+    size_t part_hlen = (sizeof(_PART_TYPE) - 1) + len_len + 4;
+    size_t tail_len = (sizeof(_PART_TAIL) - 1) - (client->raw ? 2 : 0);
+
+    char head[96];
+    char * p = head;
+    if (!client->raw) {
+        p = put_hex(p, part_hlen + frame->len + (sizeof(_PART_TAIL) - 1) - 2);
+        *p++ = '\r';
+        *p++ = '\n';
+    }
+    memcpy(p, _PART_TYPE, sizeof(_PART_TYPE) - 1);
+    p += sizeof(_PART_TYPE) - 1;
+    memcpy(p, len_str, len_len);
+    p += len_len;
+    memcpy(p, "\r\n\r\n", 4);
+    p += 4;
+
+    struct iovec iov[3] = {
+        { head, (size_t)(p - head) },
+        { frame->buf, frame->len },
+        { (void *)_PART_TAIL, tail_len }
+    };
+    return client_writev(client, iov, 3);
+}
+
+// Send one frame as a single binary WebSocket message: the frame header
+// (server messages are not masked), our header and the JPEG, in one write
+static bool client_send_message(stream_client_t * client, const frame_t * frame) {
+    uint64_t len = STREAM_WS_HEADER + frame->len;
+    uint8_t head[10 + STREAM_WS_HEADER];
+    uint8_t * p = head;
+    *p++ = 0x82;                  // FIN, binary
+    if (len < 126) {
+        *p++ = len;
+    } else if (len < 65536) {
+        *p++ = 126;
+        *p++ = len >> 8;
+        *p++ = len & 0xff;
+    } else {
+        *p++ = 127;
+        for (int i = 7; i >= 0; i--) *p++ = (len >> (i * 8)) & 0xff;
+    }
+    p = put_le(p, frame->seq, 4);
+    p = put_le(p, frame->len, 4);
+    p = put_le(p, frame->timestamp, 8);
+    p = put_le(p, esp_timer_get_time(), 8);
+
+    struct iovec iov[2] = {
+        { head, (size_t)(p - head) },
+        { frame->buf, frame->len }
+    };
+    return client_writev(client, iov, 2);
+}
+
+static void client_task(void * arg) {
+    stream_client_t * client = (stream_client_t *)arg;
+    uint32_t seq = 0;
+    uint32_t caught_up = 0;       // newest frame published before the socket last had room again
+    int64_t last_frame = esp_timer_get_time();
+
+    while (!client->closed && !client->killed) {
+        // Pongs and closes from the /ws handler go out here, so they never land inside a frame
+        if (client->controlLen) {
+            uint8_t control[sizeof(client->control)];
+            xSemaphoreTake(streamLock, portMAX_DELAY);
+            size_t len = client->controlLen;
+            memcpy(control, client->control, len);
+            client->controlLen = 0;
+            xSemaphoreGive(streamLock);
+            if (!client_send(client, (const char *)control, len) || (control[0] == 0x88)) break;
+        }
+        // Per-client pacing; a stop or close notifies us, so sleep on that
+        int64_t wait = pacerDelay(&client->pacer);
+        if (wait > 0) {
+            ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(wait / 1000) + 1);
+            continue;
+        }
+        // A WebSocket client doing flow control is only sent what it has asked for
+        if (client->credited && (client->credits <= 0)) {
+            ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(1000));
+            continue;
+        }
+        // Only pick a frame once the socket has room again (lwIP's select()
+        // says writable once its send buffer is below the low water mark), so
+        // frames published while the client is backed up are passed over and
+        // the newest one is sent; the sender never queues old frames
+        if (!client_wait_writable(client, 0)) {
+            if (!client_wait_writable(client, 1000)) continue;
+            caught_up = frameRingSeq();
+        }
+        uint32_t wanted = seq ? seq + client->skip : 0;
+        frame_t * frame = frameRingWaitNewer(wanted, pdMS_TO_TICKS(1000));
+        if (!frame) continue;
+        if (seq) {
+            // Only frames published while the socket was full are dropped; the
+            // rest were passed over on purpose, by ?skip= or the client's pacing
+            uint32_t last = min(caught_up, frame->seq - 1);
+            uint32_t dropped = (last > wanted) ? last - wanted : 0;
+            client->dropped += dropped;
+            client->skipped += frame->seq - seq - 1 - dropped;
+            if (dropped) metricsFramesDropped(dropped);
+        }
+        seq = frame->seq;
+        pacerTake(&client->pacer);
+
+        size_t jpg_len = frame->len;
+        int64_t send_start = esp_timer_get_time();
+        bool ok = client->ws ? client_send_message(client, frame) : client_send_part(client, frame);
+        int64_t send_time = esp_timer_get_time() - send_start;
+        if (client->backedUp) {
+            caught_up = frameRingSeq();
+            client->backedUp = false;
+        }
+        frameRingRelease(frame);
+        if (!ok) {
+            // The connection has been interrupted
+            if (!client->closed) Serial.printf("Stream %i failed to send\r\n", client->fd);
+            break;
+        }
+
+        client->frames++;
+        client->sendTime += send_time;
+        if (client->credited) {
+            xSemaphoreTake(streamLock, portMAX_DELAY);
+            client->credits--;
+            xSemaphoreGive(streamLock);
+        }
+        abrFrameSent(jpg_len, send_time);
+        metricsFrameSent(jpg_len, send_time);
+        int64_t frame_time = (esp_timer_get_time() - last_frame) / 1000;
+        last_frame = esp_timer_get_time();
+        if (debugData) {
+            Serial.printf("MJPG[%i]: %uB %ums, send %uus (avg %uus), dropped %u, framerate (%.1ffps, target %.1ffps)\r\n",
+                client->fd, (uint32_t)jpg_len, (uint32_t)frame_time, (uint32_t)send_time,
+                (uint32_t)(client->sendTime / client->frames), client->dropped,
+                client->pacer.fps, pacerTargetFps(&client->pacer));
+        }
+    }
+    if (client->killed) {
+        // End the chunked response or the WebSocket cleanly; a raw response just ends with the connection
+        if (client->ws) client_send(client, "\x88\x02\x03\xe9", 4);    // close, 1001 going away
+        else if (!client->raw) client_send(client, "0\r\n\r\n", 5);
+        Serial.printf("Stream %i killed\r\n", client->fd);
+    }
+
+    xSemaphoreTake(streamLock, portMAX_DELAY);
+    for (int i = 0; i < MAX_STREAMS; i++) {
+        if (clients[i] == client) clients[i] = NULL;
+    }
+    client->task = NULL;        // nobody may notify this task once it has gone
+    streamCount--;
+    streamsServed++;
+    bool lastClient = (streamCount == 0);
+    xSemaphoreGive(streamLock);
+    if (lastClient && autoLamp && (lampVal != -1)) fadeLamp(0);
+    eventsNotify();
+    Serial.printf("Stream %i ended after %u frames, %u dropped, %i remaining\r\n",
+        client->fd, client->frames, client->dropped, streamCount);
+
+    if (!client->closed) httpd_sess_trigger_close(client->hd, client->fd);
+    client_put(client);
+    vTaskDelete(NULL);
+}
+
+void streamInit() {
+    if (streamLock) return;
+    frameRingInit();
+    abrInit();
+    streamLock = xSemaphoreCreateMutex();
+    cameraLock = xSemaphoreCreateMutex();
+    xTaskCreate(capture_task, "stream_capture", 4096, NULL, 5, &captureTask);
+}
+
+// Per-client options from the stream URL query string
+static void client_parse_query(httpd_req_t *req, stream_client_t * client) {
+    size_t buf_len = httpd_req_get_url_query_len(req) + 1;
+    if (buf_len <= 1) return;
+    char * buf = (char *)malloc(buf_len);
+    if (!buf) return;
+    if (httpd_req_get_url_query_str(req, buf, buf_len) == ESP_OK) {
+        char value[16] = {0,};
+        if (httpd_query_key_value(buf, "mode", value, sizeof(value)) == ESP_OK) {
+            client->raw = (strcmp(value, "raw") == 0);
+        }
+        if (httpd_query_key_value(buf, "fps", value, sizeof(value)) == ESP_OK) {
+            float fps = atof(value);
+            if (fps > 0) pacerInit(&client->pacer, (int64_t)(1000000 / fps), PACER_BURST);
+        }
+        if (httpd_query_key_value(buf, "skip", value, sizeof(value)) == ESP_OK) {
+            client->skip = max(atoi(value), 0);
+        }
+    }
+    free(buf);
+}
+
+static esp_err_t start_client(httpd_req_t *req, bool ws) {
+    // Reserve a slot before anything is sent
+    xSemaphoreTake(streamLock, portMAX_DELAY);
+    int slot = -1;
+    for (int i = 0; i < MAX_STREAMS; i++) {
+        if (clients[i] == NULL) {
+            slot = i;
+            break;
+        }
+    }
+    stream_client_t * client = NULL;
+    if (slot >= 0) {
+        client = (stream_client_t *)calloc(1, sizeof(stream_client_t));
+        if (client) clients[slot] = client;
+    }
+    xSemaphoreGive(streamLock);
+
+    if (slot < 0) {
+        Serial.printf("STREAM: refused, all %i stream slots are in use\r\n", MAX_STREAMS);
+        httpd_resp_set_status(req, "503 Service Unavailable");
+        httpd_resp_set_hdr(req, "Access-Control-Allow-Origin", "*");
+        httpd_resp_send(req, NULL, 0);
+        return ESP_FAIL;
+    }
+    if (!client) {
+        httpd_resp_send_500(req);
+        return ESP_FAIL;
+    }
+
+    client->hd = req->handle;
+    client->fd = httpd_req_to_sockfd(req);
+    client->refs = 2;
+    client->sendLock = xSemaphoreCreateMutex();
+    pacerInit(&client->pacer, 0, PACER_BURST);
+    client_parse_query(req, client);
+    client->ws = ws;
+
+    esp_err_t res = ESP_OK;
+    if (client->ws) {
+        // httpd has already completed the WebSocket handshake
+        client->raw = false;
+    } else if (client->raw) {
+        // Write the response headers and the opening boundary ourselves
+        if (!client_send(client, _RAW_HEADERS, sizeof(_RAW_HEADERS) - 1)) res = ESP_FAIL;
+    } else {
+        // Let httpd send the response headers and the opening boundary
+        res = httpd_resp_set_type(req, _STREAM_CONTENT_TYPE);
+        if (res == ESP_OK) {
+            httpd_resp_set_hdr(req, "Access-Control-Allow-Origin", "*");
+            res = httpd_resp_send_chunk(req, _STREAM_BOUNDARY, strlen(_STREAM_BOUNDARY));
+        }
+    }
+    bool firstClient = false;
+    if (res == ESP_OK) {
+        xSemaphoreTake(streamLock, portMAX_DELAY);
+        if (xTaskCreate(client_task, "stream_client", 4096, client, 5, &client->task) != pdPASS) {
+            res = ESP_ERR_NO_MEM;
+        } else {
+            firstClient = (++streamCount == 1);
+        }
+        xSemaphoreGive(streamLock);
+    }
+    if (res != ESP_OK) {
+        Serial.printf("STREAM: failed to start, code = %i : %s\r\n", res, esp_err_to_name(res));
+        xSemaphoreTake(streamLock, portMAX_DELAY);
+        clients[slot] = NULL;
+        xSemaphoreGive(streamLock);
+        vSemaphoreDelete(client->sendLock);
+        free(client);
+        return res;
+    }
+
+    // The sender task now owns the socket; httpd tells us when it closes
+    req->sess_ctx = client;
+    req->free_ctx = client_session_closed;
+
+    if (firstClient && autoLamp && (lampVal != -1)) fadeLamp(lampVal);
+    xTaskNotifyGive(captureTask);
+    eventsNotify();
+    Serial.printf("Stream %i started%s, fps %.1f, skip %u, %i active\r\n", client->fd,
+        client->ws ? " (ws)" : client->raw ? " (raw)" : "", pacerTargetFps(&client->pacer), client->skip, streamCount);
+    return ESP_OK;
+}
+
+esp_err_t streamStartClient(httpd_req_t *req) {
+    return start_client(req, false);
+}
+
+#ifdef CONFIG_HTTPD_WS_SUPPORT
+// Handler for /ws, registered with is_websocket and handle_ws_control_frames
+// set. httpd calls it once the handshake is done, then for every message the
+// client sends; a text message holding a number grants that many more frames.
+// Pings and closes are answered by the sender task rather than by httpd, which
+// would write its reply straight into the middle of a frame being sent.
+esp_err_t streamWsHandler(httpd_req_t *req) {
+    if (req->method == HTTP_GET) return start_client(req, true);
+
+    httpd_ws_frame_t pkt;
+    memset(&pkt, 0, sizeof(pkt));
+    esp_err_t res = httpd_ws_recv_frame(req, &pkt, 0);
+    if (res != ESP_OK) return res;
+    uint8_t payload[STREAM_WS_CONTROL_MAX + 1] = {0,};
+    if (pkt.len > STREAM_WS_CONTROL_MAX) return ESP_FAIL;
+    pkt.payload = payload;
+    res = httpd_ws_recv_frame(req, &pkt, STREAM_WS_CONTROL_MAX);
+    if (res != ESP_OK) return res;
+
+    stream_client_t * client = (stream_client_t *)req->sess_ctx;
+    if (!client) return (pkt.type == HTTPD_WS_TYPE_CLOSE) ? ESP_FAIL : ESP_OK;
+    if (pkt.type == HTTPD_WS_TYPE_TEXT) {
+        int credits = atoi((const char *)payload);
+        xSemaphoreTake(streamLock, portMAX_DELAY);
+        client->credited = true;
+        client->credits = min(client->credits + max(credits, 0), STREAM_WS_MAX_CREDITS);
+        if (client->task) xTaskNotifyGive(client->task);
+        xSemaphoreGive(streamLock);
+    } else if ((pkt.type == HTTPD_WS_TYPE_PING) || (pkt.type == HTTPD_WS_TYPE_CLOSE)) {
+        bool close = (pkt.type == HTTPD_WS_TYPE_CLOSE);
+        // A close echoes just the status code; once one is queued nothing replaces it
+        size_t len = close ? min(pkt.len, (size_t)2) : pkt.len;
+        xSemaphoreTake(streamLock, portMAX_DELAY);
+        if ((client->controlLen == 0) || (client->control[0] != 0x88)) {
+            client->control[0] = close ? 0x88 : 0x8a;
+            client->control[1] = len;
+            memcpy(client->control + 2, payload, len);
+            client->controlLen = len + 2;
+        }
+        if (client->task) xTaskNotifyGive(client->task);
+        xSemaphoreGive(streamLock);
+    }
+    return ESP_OK;
+}
+#endif
+
+int streamGetStats(stream_stats_t * stats, int max) {
+    int n = 0;
+    xSemaphoreTake(streamLock, portMAX_DELAY);
+    for (int i = 0; (i < MAX_STREAMS) && (n < max); i++) {
+        stream_client_t * client = clients[i];
+        if (!client || !client->task) continue;
+        stats[n].fd = client->fd;
+        stats[n].raw = client->raw;
+        stats[n].ws = client->ws;
+        stats[n].frames = client->frames;
+        stats[n].dropped = client->dropped;
+        stats[n].skipped = client->skipped;
+        stats[n].pending = client->pending;
+        stats[n].fps = client->pacer.fps;
+        stats[n].fpsTarget = pacerTargetFps(&client->pacer);
+        n++;
+    }
+    xSemaphoreGive(streamLock);
+    return n;
+}
+
+// Achieved and target capture rate; a target of 0 means unlimited
+void streamGetFps(float * fps, float * target) {
+    *fps = (streamCount > 0) ? capturePacer.fps : 0;
+    *target = pacerTargetFps(&capturePacer);
+}
+
+void streamStopAll() {
+    xSemaphoreTake(streamLock, portMAX_DELAY);
+    for (int i = 0; i < MAX_STREAMS; i++) {
+        if (clients[i] && clients[i]->task) {
+            clients[i]->killed = true;
+            xTaskNotifyGive(clients[i]->task);
+        }
+    }
+    xSemaphoreGive(streamLock);
+}
+
+// Hold off the capture loop, for sensor changes that should land between two frames
+void streamPauseCapture() {
+    if (!cameraLock) return;
+    __atomic_add_fetch(&pausing, 1, __ATOMIC_RELEASE);
+    xSemaphoreTake(cameraLock, portMAX_DELAY);
+    __atomic_sub_fetch(&pausing, 1, __ATOMIC_RELEASE);
+}
+
+void streamResumeCapture() {
+    if (cameraLock) xSemaphoreGive(cameraLock);
+}
+
+// Get a fresh frame for a one-off consumer such as /capture. While streams
+// are running this is the next frame the capture task publishes, so it costs
+// no extra sensor read; otherwise a frame is grabbed directly.
+frame_t * streamGrabFrame() {
+    if (streamCount > 0) {
+        uint32_t seq = frameRingSeq();
+        int64_t start = esp_timer_get_time();
+        do {
+            frame_t * frame = frameRingWaitNewer(seq, pdMS_TO_TICKS(1000));
+            if (frame) return frame;
+        } while ((streamCount > 0) && (esp_timer_get_time() - start < 3000000));
+    }
+    if (!capture_frame()) return NULL;
+    return frameRingLatest();
+}
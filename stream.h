@@ -0,0 +1,57 @@
+//
+// Multi-client MJPEG stream broadcaster.
+//
+// A single capture task publishes each frame once into the frame ring;
+// every connected client has its own sender task that pulls the latest
+// frame from it.
+//
+
+#pragma once
+
+#include <esp_http_server.h>
+#include "framering.h"
+
+// Maximum number of simultaneous stream clients
+#define MAX_STREAMS 4
+
+// A client whose socket fills up with more than this many bytes of a frame
+// still to go is backed up: the frames published until it has caught up are
+// dropped, and it is sent the newest one next. Below it, a full socket is
+// just TCP taking its time, and frames passed over are not counted as drops.
+#define STREAM_BACKLOG_MAX 8192
+
+// Sockets the stream server may have open: the streams, and one for /info, /view or a refused client
+#define STREAM_MAX_SOCKETS (MAX_STREAMS + 1)
+
+// Every WebSocket message carries one JPEG after this header; all fields little endian:
+//   uint32 sequence number, uint32 JPEG size,
+//   uint64 capture time and uint64 send time, both in microseconds since boot
+#define STREAM_WS_HEADER 24
+
+// Most frames a WebSocket client can have outstanding credit for
+#define STREAM_WS_MAX_CREDITS 16
+
+// Snapshot of one connected client, for status pages
+typedef struct {
+    int fd;
+    bool raw;
+    bool ws;
+    uint32_t frames;      // frames sent
+    uint32_t dropped;     // frames skipped while the client was backed up
+    uint32_t skipped;     // frames passed over by its fps or skip option
+    size_t pending;       // bytes of the current frame still to be sent
+    float fps;            // achieved frame rate
+    float fpsTarget;      // requested frame rate, 0 = unlimited
+} stream_stats_t;
+
+extern void streamInit();
+extern esp_err_t streamStartClient(httpd_req_t *req);
+#ifdef CONFIG_HTTPD_WS_SUPPORT
+extern esp_err_t streamWsHandler(httpd_req_t *req);
+#endif
+extern void streamStopAll();
+extern frame_t * streamGrabFrame();
+extern void streamPauseCapture();
+extern void streamResumeCapture();
+extern int streamGetStats(stream_stats_t * stats, int max);
+extern void streamGetFps(float * fps, float * target);